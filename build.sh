@@ -1,13 +1,118 @@
 CC="clang"
 
 CFLAGS="-Wall -Werror -fsanitize=address "
-CFLAGS+="-lSDL2 -lSDL2_gfx -lSDL2_ttf -lSDL2_mixer -Isrc/include"
+CFLAGS+="-Isrc/include"
+
+SDL_LIBS="-lSDL2 -lSDL2_gfx -lSDL2_ttf -lSDL2_mixer -lpthread -lrt"
+HEADLESS_LIBS="-lpthread -lrt -lm"
 
 BASE="src/library/"
-CFILES="${BASE}sdl_wrapper.c "
-CFILES+="${BASE}polygon.c "
+CFILES="${BASE}polygon.c "
 CFILES+="${BASE}vector.c "
 CFILES+="${BASE}collision.c "
-CFILES+="src/game.c"
+CFILES+="${BASE}gjk.c "
+CFILES+="${BASE}physics.c "
+CFILES+="${BASE}capture.c "
+CFILES+="${BASE}state_export.c "
+CFILES+="${BASE}timer.c "
+CFILES+="${BASE}scale_controller.c "
+CFILES+="${BASE}vertex_arena.c "
+CFILES+="${BASE}scenario.c "
+CFILES+="${BASE}histogram.c "
+CFILES+="${BASE}state_stream.c "
+CFILES+="${BASE}replay.c "
+CFILES+="${BASE}perf_counters.c "
+CFILES+="${BASE}jobs.c "
+CFILES+="${BASE}trig.c "
+CFILES+="${BASE}quality_governor.c "
+CFILES+="${BASE}memory_budget.c "
+
+# Windowed game, drawn with SDL
+$CC $CFLAGS $SDL_LIBS ${BASE}sdl_wrapper.c $CFILES src/game.c -o game
+
+# Headless game, drawn with the software rasterizer
+$CC $CFLAGS ${BASE}soft_wrapper.c ${BASE}raster.c $CFILES src/game.c \
+    $HEADLESS_LIBS -o game_headless
+
+# Headless game with the other capacity profiles of const.h: room for the
+# stress scenarios, and pools cut down for memory-constrained targets
+for PROFILE in stress embedded; do
+    $CC $CFLAGS -DCAPACITY_$(echo $PROFILE | tr a-z A-Z) ${BASE}soft_wrapper.c \
+        ${BASE}raster.c $CFILES src/game.c $HEADLESS_LIBS -o game_headless_$PROFILE
+done
+
+# Static memory of each profile by subsystem, already held to its budgets
+# by _Static_assert
+for GAME in game_headless game_headless_stress game_headless_embedded; do
+    ./$GAME --memory-report 0 | sed -n '/^profile/,/^total/p'
+done
+
+# Software rasterizer throughput benchmark
+$CC $CFLAGS ${BASE}raster.c $CFILES src/bench/raster_bench.c \
+    $HEADLESS_LIBS -o raster_bench
+
+# Asteroid drawing benchmark, filled polygons against cached sprites
+$CC $CFLAGS $SDL_LIBS ${BASE}sdl_wrapper.c $CFILES src/bench/sprite_bench.c \
+    -o sprite_bench
+
+# Geometry library microbenchmarks, compare with
+# geometry_bench_release 1048576 src/bench/geometry_baseline.csv
+$CC $CFLAGS $CFILES src/bench/geometry_bench.c $HEADLESS_LIBS -o geometry_bench
+
+# The same with the polynomial sine and cosine of trig.h instead of libm
+$CC $CFLAGS -DFAST_TRIG $CFILES src/bench/geometry_bench.c $HEADLESS_LIBS \
+    -o geometry_bench_fast_trig
+
+# Reader for the shared memory state export
+$CC $CFLAGS ${BASE}state_export.c src/tools/state_reader.c -lrt -o state_reader
+
+# Decoder for the delta-compressed state stream, from a file or a socket
+$CC $CFLAGS ${BASE}state_stream.c src/tools/stream_reader.c $HEADLESS_LIBS \
+    -o stream_reader
+
+# Headless game, geometry differential check and geometry benchmark for
+# each scalar precision mode: f64 (default), f32 and 16.16 fixed point.
+# Compare them with game_headless*  --tick-bench and precision_bench*;
+# geometry_bench_fixed also checks the edges too short to project onto.
+for MODE in "" "f32" "fixed"; do
+    SUFFIX="${MODE:+_$MODE}"
+    DEFINE="${MODE:+-DSCALAR_$(echo $MODE | tr a-z A-Z)}"
+    if [ -n "$MODE" ]; then
+        $CC $CFLAGS $DEFINE ${BASE}soft_wrapper.c ${BASE}raster.c $CFILES \
+            src/game.c $HEADLESS_LIBS -o game_headless$SUFFIX
+        $CC $CFLAGS $DEFINE $CFILES src/bench/geometry_bench.c \
+            $HEADLESS_LIBS -o geometry_bench$SUFFIX
+    fi
+    $CC $CFLAGS $DEFINE $CFILES src/bench/precision_bench.c \
+        $HEADLESS_LIBS -o precision_bench$SUFFIX
+done
+
+# Release builds: -O3 and LTO, optimized with a profile gathered by running
+# instrumented builds of the geometry benchmark, the tick and rollback
+# benchmarks and a short soak. Set LLVM_PROFDATA if it is not on the path.
+RELEASE_FLAGS="-O3 -flto -DNDEBUG -Wall -Werror -Isrc/include"
+LLVM_PROFDATA="${LLVM_PROFDATA:-llvm-profdata}"
+PGO_DIR="pgo"
+rm -rf $PGO_DIR && mkdir -p $PGO_DIR
+
+PGO_GEN="-fprofile-instr-generate=$PGO_DIR/%p.profraw"
+$CC $RELEASE_FLAGS $PGO_GEN ${BASE}soft_wrapper.c ${BASE}raster.c $CFILES \
+    src/game.c $HEADLESS_LIBS -o $PGO_DIR/game_headless
+$CC $RELEASE_FLAGS $PGO_GEN $CFILES src/bench/geometry_bench.c \
+    $HEADLESS_LIBS -o $PGO_DIR/geometry_bench
+$PGO_DIR/geometry_bench 100000 > /dev/null
+$PGO_DIR/game_headless --tick-bench 20000 > /dev/null
+$PGO_DIR/game_headless --rollback-bench 200 > /dev/null
+$PGO_DIR/game_headless --soak scenarios/training.txt > /dev/null
+$LLVM_PROFDATA merge -output=$PGO_DIR/game.profdata $PGO_DIR/*.profraw
 
-$CC $CFLAGS $CFILES -o game
+# Functions the training runs never reach, like the SDL backend, just get
+# no profile
+PGO_USE="-fprofile-instr-use=$PGO_DIR/game.profdata "
+PGO_USE+="-Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date"
+$CC $RELEASE_FLAGS $PGO_USE $SDL_LIBS ${BASE}sdl_wrapper.c $CFILES src/game.c \
+    -o game_release
+$CC $RELEASE_FLAGS $PGO_USE ${BASE}soft_wrapper.c ${BASE}raster.c $CFILES \
+    src/game.c $HEADLESS_LIBS -o game_headless_release
+$CC $RELEASE_FLAGS $PGO_USE $CFILES src/bench/geometry_bench.c \
+    $HEADLESS_LIBS -o geometry_bench_release
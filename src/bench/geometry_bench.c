@@ -0,0 +1,758 @@
+#include <string.h>
+
+#include "base.h"
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+#include "collision.h"
+#include "gjk.h"
+#include "trig.h"
+#include "timer.h"
+
+/*
+ * Microbenchmarks for every function of the geometry library, and for the
+ * collision test on hits, first-axis rejects and last-axis rejects at each
+ * vertex count.
+ *
+ * Usage: geometry_bench [iterations] [baseline.csv]
+ *
+ * Results go to stdout as CSV (scalar,name,n,ns). Given a baseline in the
+ * same format, two more columns give the baseline time and the ratio, and
+ * the exit status is 1 if anything got slower than BENCH_TOLERANCE times
+ * the baseline. For vertex counts with unrolled kernels the generic loops
+ * are timed too (the *_generic rows), and the kernels are checked to give
+ * exactly the generic results. The *_warm rows are the same pairs warm
+ * started from the hint their last test left, with the hint hit rate and
+ * the axis tests it saved printed to stderr, and warm started results
+ * (from every possible hint) are checked against cold ones. GJK and EPA
+ * are timed on the same pairs (gjk_*, epa_hit) and on random convex pairs
+ * of up to 64 vertices next to SAT (*_random), with the vertex count from
+ * which GJK wins printed to stderr, and cross-checked against SAT and
+ * exact circle tests, see check_gjk(). Polygons with edges too short to
+ * project onto in 16.16 are checked too, see check_short_edges(). Fast
+ * sine and cosine are checked against libm, with the error printed to
+ * stderr. Built with -DFAST_TRIG the scalar column reads e.g.
+ * f64+fast_trig. Regenerate src/bench/geometry_baseline.csv on the
+ * machine the comparison runs on.
+ */
+
+#define BENCH_INPUTS 1024
+#define BENCH_SHAPES 64
+#define BENCH_MAX_RESULTS 256
+#define CONVEX_MAX_POINTS 64
+
+const f64 BENCH_TOLERANCE = 1.25;
+const usize TRIG_SAMPLES = 1 << 20;
+const f64 TRIG_RANGES[] = { 2.0 * M_PI, 1e3, 1e5 };
+
+#if defined(FAST_TRIG)
+#define TRIG_SUFFIX "+fast_trig"
+#else
+#define TRIG_SUFFIX ""
+#endif
+const usize BENCH_VERTEX_COUNTS[] = { 3, 4, 6, 8, 10 };
+const usize CONVEX_VERTEX_COUNTS[] = { 3, 4, 6, 8, 10, 16, 24, 32, 48, 64 };
+const usize CONVEX_PAIRS = 1 << 14;
+
+typedef struct {
+    char scalar[16];
+    char name[64];
+    usize n;
+    f64 ns;
+} Result;
+
+static Vector2 va[BENCH_INPUTS];
+static Vector2 vb[BENCH_INPUTS];
+static f64 angles[BENCH_INPUTS];
+static Vector2 points[2][BENCH_SHAPES][MAX_POINTS];
+static Polygon shapes[2][BENCH_SHAPES];
+static SatHint hints[BENCH_SHAPES];
+static Vector2 convex_points[2][BENCH_SHAPES][CONVEX_MAX_POINTS];
+static Polygon convex[2][BENCH_SHAPES];
+static Result results[BENCH_MAX_RESULTS];
+static usize num_results;
+static volatile f64 sink;
+
+static u64 rng = 0x9e3779b97f4a7c15;
+
+static f64 rand_f64(f64 min, f64 max)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    u32 r = (rng * 0x2545f4914f6cdd1d) >> 32;
+    return (max - min) * (f64) r / (f64) UINT32_MAX + min;
+}
+
+static void record(const char *name, usize n, f64 secs, usize ops)
+{
+    assert(num_results < BENCH_MAX_RESULTS);
+    Result *r = &results[num_results++];
+    snprintf(r->scalar, sizeof(r->scalar), "%s%s", SCALAR_NAME, TRIG_SUFFIX);
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->n = n;
+    r->ns = 1e9 * secs / ops;
+}
+
+/* Time body over iterations, with k cycling through the inputs */
+#define BENCH(name, n, body) \
+    do { \
+        f64 acc = 0.0; \
+        f64 start = timer_now(); \
+        for (usize it = 0; it < iterations; it++) { \
+            usize k = it & (BENCH_INPUTS - 1); \
+            body; \
+        } \
+        record(name, n, timer_now() - start, iterations); \
+        sink = acc; \
+    } while (0)
+
+/* A regular n-gon of radius r around c with its first vertex at angle 0 */
+static void make_shape(Polygon *poly, Vector2 *storage, usize n, Vector2 c, f64 r)
+{
+    poly->points = storage;
+    poly->n = n;
+    for (usize i = 0; i < n; i++) {
+        f64 theta = 2.0 * M_PI * i / n;
+        poly->points[i] = vec_add(c, vec(r * cos(theta), r * sin(theta)));
+    }
+}
+
+/*
+ * Place the second shape of each pair relative to the first: overlapping,
+ * far away along the first axis tested, or just clear of the first shape
+ * along the last axis of the first shape, which is only found at the end.
+ */
+typedef enum {
+    PAIR_HIT,
+    PAIR_REJECT_FIRST,
+    PAIR_REJECT_LAST,
+} PairKind;
+
+static void make_pairs(usize n, PairKind kind)
+{
+    f64 step = 2.0 * M_PI / n;
+    f64 apothem = cos(step / 2.0);
+    for (usize i = 0; i < BENCH_SHAPES; i++) {
+        f64 r = rand_f64(10.0, 60.0);
+        Vector2 c = vec(rand_f64(-WIDTH / 2.0, WIDTH / 2.0),
+                        rand_f64(-HEIGHT / 2.0, HEIGHT / 2.0));
+        make_shape(&shapes[0][i], points[0][i], n, c, r);
+        f64 dist = 0.0;
+        f64 theta = 0.0;
+        switch (kind) {
+            case PAIR_HIT:
+            {
+                dist = 0.5 * r;
+                theta = rand_f64(0.0, 2.0 * M_PI);
+            } break;
+            case PAIR_REJECT_FIRST:
+            {
+                dist = 10.0 * r;
+                theta = 0.5 * step;
+            } break;
+            case PAIR_REJECT_LAST:
+            {
+                dist = (apothem + 1.02) * r;
+                theta = (n - 0.5) * step;
+            } break;
+        }
+        Vector2 d = vec(dist * cos(theta), dist * sin(theta));
+        make_shape(&shapes[1][i], points[1][i], n, vec_add(c, d), r);
+    }
+}
+
+static void bench_vectors(usize iterations)
+{
+    for (usize i = 0; i < BENCH_INPUTS; i++) {
+        va[i] = vec(rand_f64(-500.0, 500.0), rand_f64(-500.0, 500.0));
+        vb[i] = vec(rand_f64(-1.0, 1.0), rand_f64(-1.0, 1.0));
+        angles[i] = rand_f64(-M_PI, M_PI);
+    }
+    BENCH("vec", 0, acc += scalar_to_f64(vec(angles[k], angles[k]).x));
+    BENCH("vec_mul", 0, acc += scalar_to_f64(vec_mul(angles[k], va[k]).x));
+    BENCH("vec_add", 0, acc += scalar_to_f64(vec_add(va[k], vb[k]).x));
+    BENCH("vec_sub", 0, acc += scalar_to_f64(vec_sub(va[k], vb[k]).x));
+    BENCH("vec_cross", 0, acc += wide_to_f64(vec_cross(va[k], vb[k])));
+    BENCH("vec_dot", 0, acc += wide_to_f64(vec_dot(va[k], vb[k])));
+    BENCH("vec_proj", 0, acc += scalar_to_f64(vec_proj(va[k], vb[k]).x));
+    BENCH("vec_rotate", 0, acc += scalar_to_f64(vec_rotate(angles[k], va[k]).x));
+}
+
+/*
+ * Sine and cosine on their own and as the game calls them: the player's
+ * heading (trig_sincos), rotations through the cache when the angle
+ * repeats and when it does not. vec_rotate, poly_rotate and
+ * find_collision above are the other call sites.
+ */
+static void bench_trig(usize iterations)
+{
+    BENCH("sincos_libm", 0, {
+        f64 s;
+        f64 c;
+        trig_sincos_libm(angles[k], &s, &c);
+        acc += s + c;
+    });
+    BENCH("sincos_fast", 0, {
+        f64 s;
+        f64 c;
+        trig_sincos_fast(angles[k], &s, &c);
+        acc += s + c;
+    });
+    BENCH("trig_sincos", 0, {
+        f64 s;
+        f64 c;
+        trig_sincos(angles[k], &s, &c);
+        acc += s + c;
+    });
+    BENCH("trig_rotation_repeat", 0,
+        acc += scalar_to_f64(trig_rotation(angles[k & 7]).c));
+    BENCH("trig_rotation_new", 0,
+        acc += scalar_to_f64(trig_rotation(angles[k] + 1e-9 * it).c));
+}
+
+/*
+ * Largest error of trig_sincos_fast() against libm over random angles
+ * within each range, and whether the cache returns what it would compute.
+ * False if anything is out of bounds.
+ */
+static bool check_trig(void)
+{
+    bool ok = true;
+    for (usize r = 0; r < sizeof(TRIG_RANGES) / sizeof(f64); r++) {
+        f64 worst = 0.0;
+        f64 worst_theta = 0.0;
+        for (usize i = 0; i < TRIG_SAMPLES; i++) {
+            f64 theta = rand_f64(-TRIG_RANGES[r], TRIG_RANGES[r]);
+            f64 s, c;
+            trig_sincos_fast(theta, &s, &c);
+            f64 err = fmax(fabs(s - sin(theta)), fabs(c - cos(theta)));
+            if (err > worst) {
+                worst = err;
+                worst_theta = theta;
+            }
+        }
+        fprintf(stderr, "sincos_fast |theta| <= %g: max error %.3g at %.6f (bound %.3g)\n",
+                TRIG_RANGES[r], worst, worst_theta, TRIG_FAST_MAX_ERROR);
+        ok = ok && worst <= TRIG_FAST_MAX_ERROR;
+    }
+    usize wrong = 0;
+    for (usize i = 0; i < BENCH_INPUTS; i++) {
+        Rotation a = trig_rotation(angles[i & 15]);
+        Rotation b = trig_rotation_uncached(angles[i & 15]);
+        wrong += memcmp(&a, &b, sizeof(a)) != 0;
+    }
+    TrigStats stats = trig_stats();
+    fprintf(stderr, "trig_rotation: %lu hits, %lu misses, %lu differing from uncached\n",
+            stats.hits, stats.misses, wrong);
+    return ok && wrong == 0;
+}
+
+static void bench_polygons(usize iterations, usize n)
+{
+    make_pairs(n, PAIR_HIT);
+    Polygon *polys = shapes[0];
+    const usize mask = BENCH_SHAPES - 1;
+
+    // Every other call undoes the one before, so shapes do not wander off
+    BENCH("poly_translate", n, {
+        Vector2 t = it & 1 ? vec_mul(-1.0, vb[k - 1]) : vb[k];
+        poly_translate(&polys[(it >> 1) & mask], t);
+    });
+    BENCH("poly_rotate", n, {
+        f64 theta = it & 1 ? -angles[k - 1] : angles[k];
+        poly_rotate(&polys[(it >> 1) & mask], theta, va[k & ~(usize) 1]);
+    });
+    BENCH("poly_min", n, acc += scalar_to_f64(poly_min(&polys[k & mask]).x));
+    BENCH("poly_max", n, acc += scalar_to_f64(poly_max(&polys[k & mask]).x));
+    BENCH("poly_area", n, acc += wide_to_f64(poly_area(&polys[k & mask])));
+    BENCH("poly_centroid", n, acc += scalar_to_f64(poly_centroid(&polys[k & mask]).x));
+    if (!poly_has_kernel(n)) {
+        return;
+    }
+
+    // The same through the generic loops, for the speedup of the kernels
+    BENCH("poly_translate_generic", n, {
+        Vector2 t = it & 1 ? vec_mul(-1.0, vb[k - 1]) : vb[k];
+        poly_translate_generic(&polys[(it >> 1) & mask], t);
+    });
+    BENCH("poly_rotate_generic", n, {
+        f64 theta = it & 1 ? -angles[k - 1] : angles[k];
+        poly_rotate_generic(&polys[(it >> 1) & mask], theta, va[k & ~(usize) 1]);
+    });
+    BENCH("poly_min_generic", n,
+        acc += scalar_to_f64(poly_min_generic(&polys[k & mask]).x));
+    BENCH("poly_max_generic", n,
+        acc += scalar_to_f64(poly_max_generic(&polys[k & mask]).x));
+    BENCH("poly_centroid_generic", n,
+        acc += scalar_to_f64(poly_centroid_generic(&polys[k & mask]).x));
+}
+
+/* Kernels must give exactly what the generic loops give, false if not */
+static bool check_kernels(usize n)
+{
+    static Vector2 copy[MAX_POINTS];
+    usize wrong = 0;
+    for (PairKind kind = PAIR_HIT; kind <= PAIR_REJECT_LAST; kind++) {
+        make_pairs(n, kind);
+        for (usize i = 0; i < BENCH_SHAPES; i++) {
+            Polygon *p1 = &shapes[0][i];
+            Polygon *p2 = &shapes[1][i];
+            Polygon c = { .points = copy, .n = n };
+            wrong += find_collision(p1, p2) != find_collision_generic(p1, p2);
+            wrong += find_collision(p2, p1) != find_collision_generic(p2, p1);
+            for (i32 axis = SAT_NO_HINT; axis < (i32) (2 * n); axis++) {
+                SatHint hint = { .axis = axis };
+                SatStats stats = {0};
+                wrong += find_collision_warm(p1, p2, &hint, &stats) != find_collision(p1, p2);
+                wrong += hint.axis >= 0 ? !sat_axis_separates(p1, p2, hint.axis)
+                                        : hint.axis != find_separating_axis(p1, p2);
+            }
+            Vector2 a = poly_min(p1), b = poly_min_generic(p1);
+            wrong += memcmp(&a, &b, sizeof(a)) != 0;
+            a = poly_max(p1), b = poly_max_generic(p1);
+            wrong += memcmp(&a, &b, sizeof(a)) != 0;
+            a = poly_centroid(p1), b = poly_centroid_generic(p1);
+            wrong += memcmp(&a, &b, sizeof(a)) != 0;
+
+            memcpy(copy, p1->points, n * sizeof(Vector2));
+            poly_rotate(p1, angles[i], va[i]);
+            poly_translate(p1, vb[i]);
+            poly_rotate_generic(&c, angles[i], va[i]);
+            poly_translate_generic(&c, vb[i]);
+            wrong += memcmp(copy, p1->points, n * sizeof(Vector2)) != 0;
+        }
+    }
+    if (wrong) {
+        fprintf(stderr, "%lu kernel results for %lu vertices differ from the generic ones\n",
+                wrong, n);
+    }
+    return wrong == 0;
+}
+
+/*
+ * Polygons with one edge from 1/512 to 1/32 px anywhere on the screen. In
+ * 16.16 the axis of an edge under 1/256 px has no length, and for edges
+ * up to about 1/64 px projecting onto it overflows the quotient, so these
+ * test both ends of wide_div(). Pairs whose inscribed circles overlap
+ * must hit and pairs further apart than their radii must not, as in f64.
+ * False if any result differs.
+ */
+static bool check_short_edges(void)
+{
+    static Vector2 storage[2][MAX_POINTS];
+    const usize counts[] = { 4, 5, 10 };
+    const f64 edges[] = { 1.0 / 512, 1.0 / 256, 1.0 / 200, 1.0 / 128, 1.0 / 64, 1.0 / 32 };
+    const f64 dists[] = { 0.5, 0.95, 1.05, 3.0 };
+    usize pairs = 0, wrong = 0;
+    for (usize e = 0; e < sizeof(edges) / sizeof(f64); e++) {
+        for (usize c = 0; c < sizeof(counts) / sizeof(usize); c++) {
+            usize n = counts[c];
+            for (usize k = 0; k < 64; k++) {
+                f64 theta = 2.0 * M_PI * k / 64;
+                f64 r = 10.0 + k;
+                Vector2 cent = vec(rand_f64(-WIDTH / 2.0, WIDTH / 2.0),
+                                   rand_f64(-HEIGHT / 2.0, HEIGHT / 2.0));
+                Polygon a = { .points = storage[0], .n = n };
+                for (usize i = 0; i < n - 1; i++) {
+                    f64 t = theta + 2.0 * M_PI * i / (n - 1);
+                    a.points[i] = vec_add(cent, vec(r * cos(t), r * sin(t)));
+                }
+                // The short edge runs from the last vertex toward the first
+                f64 t = theta - 2.0 * M_PI / (n - 1);
+                f64 dx = cos(theta) - cos(t), dy = sin(theta) - sin(t);
+                f64 len = sqrt(dx * dx + dy * dy);
+                a.points[n - 1] = vec_sub(a.points[0],
+                        vec(edges[e] * dx / len, edges[e] * dy / len));
+
+                // Overlapping, inscribed circles overlapping, just apart, far
+                f64 inscribed = r * (cos(M_PI / (n - 1)) + cos(M_PI / n));
+                Polygon b;
+                for (usize d = 0; d < sizeof(dists) / sizeof(f64); d++) {
+                    f64 dist = d < 2 ? dists[d] * inscribed : dists[d] * 2.0 * r;
+                    Vector2 offset = vec(dist * cos(theta + 1.0), dist * sin(theta + 1.0));
+                    make_shape(&b, storage[1], n, vec_add(cent, offset), r);
+                    bool hit = d < 2;
+                    wrong += find_collision(&a, &b) != hit;
+                    wrong += find_collision(&b, &a) != hit;
+                    wrong += find_collision_generic(&a, &b) != hit;
+                    pairs += 1;
+                }
+            }
+        }
+    }
+    if (wrong) {
+        fprintf(stderr, "%lu of %lu results with 1/512 to 1/32 px edges differ from f64\n",
+                wrong, 3 * pairs);
+    }
+    return wrong == 0;
+}
+
+static void bench_collisions(usize iterations, usize n)
+{
+    const char *names[] = {
+        [PAIR_HIT] = "find_collision_hit",
+        [PAIR_REJECT_FIRST] = "find_collision_reject_first",
+        [PAIR_REJECT_LAST] = "find_collision_reject_last",
+    };
+    const usize mask = BENCH_SHAPES - 1;
+    for (PairKind kind = PAIR_HIT; kind <= PAIR_REJECT_LAST; kind++) {
+        make_pairs(n, kind);
+        usize expected = kind == PAIR_HIT;
+        usize wrong = 0;
+        char name[64];
+        BENCH(names[kind], n,
+            wrong += find_collision(&shapes[0][k & mask], &shapes[1][k & mask]) != expected);
+        if (poly_has_kernel(n)) {
+            snprintf(name, sizeof(name), "%s_generic", names[kind]);
+            BENCH(name, n,
+                wrong += find_collision_generic(
+                    &shapes[0][k & mask], &shapes[1][k & mask]) != expected);
+        }
+
+        snprintf(name, sizeof(name), "gjk_%s", names[kind] + strlen("find_collision_"));
+        BENCH(name, n,
+            wrong += find_collision_gjk(&shapes[0][k & mask], &shapes[1][k & mask]) != expected);
+        if (kind == PAIR_HIT) {
+            BENCH("epa_hit", n, {
+                ConvexShape a = shape_polygon(&shapes[0][k & mask]);
+                ConvexShape b = shape_polygon(&shapes[1][k & mask]);
+                Penetration pen;
+                wrong += !gjk_penetration(&a, &b, &pen);
+                acc += pen.depth;
+            });
+        }
+
+        // Each pair's first test leaves the hint the timed ones start from
+        SatStats stats = {0};
+        for (usize i = 0; i < BENCH_SHAPES; i++) {
+            hints[i].axis = SAT_NO_HINT;
+            find_collision_warm(&shapes[0][i], &shapes[1][i], &hints[i], &stats);
+        }
+        stats = (SatStats) {0};
+        snprintf(name, sizeof(name), "%s_warm", names[kind]);
+        BENCH(name, n,
+            wrong += find_collision_warm(&shapes[0][k & mask], &shapes[1][k & mask],
+                                         &hints[k & mask], &stats) != expected);
+        fprintf(stderr, "%s with %lu vertices: %.1f%% hint hits, %.2f axes/test, "
+                "%.2f axes/test saved\n", name, n,
+                stats.warm ? 100.0 * stats.hits / stats.warm : 0.0,
+                (f64) stats.axes / stats.tests, (f64) stats.saved / stats.tests);
+        if (wrong) {
+            fprintf(stderr, "%s with %lu vertices: %lu unexpected results\n",
+                    names[kind], n, wrong);
+        }
+    }
+}
+
+/*
+ * Random convex pairs: n vertices at random steps around a circle, and
+ * the second shape anywhere from on top of the first to well clear of it,
+ * so a little over half the pairs hit.
+ */
+static void make_convex(Polygon *poly, Vector2 *storage, usize n, Vector2 c, f64 r)
+{
+    f64 steps[CONVEX_MAX_POINTS];
+    f64 total = 0.0;
+    for (usize i = 0; i < n; i++) {
+        steps[i] = rand_f64(0.2, 1.0);
+        total += steps[i];
+    }
+    f64 theta = rand_f64(0.0, 2.0 * M_PI);
+    poly->points = storage;
+    poly->n = n;
+    for (usize i = 0; i < n; i++) {
+        poly->points[i] = vec_add(c, vec(r * cos(theta), r * sin(theta)));
+        theta += 2.0 * M_PI * steps[i] / total;
+    }
+}
+
+static void make_convex_pairs(usize n)
+{
+    for (usize i = 0; i < BENCH_SHAPES; i++) {
+        f64 r1 = rand_f64(10.0, 60.0);
+        f64 r2 = rand_f64(10.0, 60.0);
+        Vector2 c = vec(rand_f64(-WIDTH / 2.0, WIDTH / 2.0),
+                        rand_f64(-HEIGHT / 2.0, HEIGHT / 2.0));
+        f64 dist = rand_f64(0.0, 1.5 * (r1 + r2));
+        f64 theta = rand_f64(0.0, 2.0 * M_PI);
+        make_convex(&convex[0][i], convex_points[0][i], n, c, r1);
+        make_convex(&convex[1][i], convex_points[1][i], n,
+                    vec_add(c, vec(dist * cos(theta), dist * sin(theta))), r2);
+    }
+}
+
+/* poly scaled by factor about its mean vertex, into storage */
+static Polygon scaled_copy(const Polygon *poly, Vector2 *storage, f64 factor)
+{
+    f64 cx = 0.0;
+    f64 cy = 0.0;
+    for (usize i = 0; i < poly->n; i++) {
+        cx += scalar_to_f64(poly->points[i].x) / poly->n;
+        cy += scalar_to_f64(poly->points[i].y) / poly->n;
+    }
+    for (usize i = 0; i < poly->n; i++) {
+        f64 x = scalar_to_f64(poly->points[i].x);
+        f64 y = scalar_to_f64(poly->points[i].y);
+        storage[i] = vec(cx + factor * (x - cx), cy + factor * (y - cy));
+    }
+    return (Polygon) { .points = storage, .n = poly->n };
+}
+
+static Polygon moved_copy(const Polygon *poly, Vector2 *storage, f64 dx, f64 dy)
+{
+    memcpy(storage, poly->points, poly->n * sizeof(Vector2));
+    Polygon copy = { .points = storage, .n = poly->n };
+    poly_translate_generic(&copy, vec(dx, dy));
+    return copy;
+}
+
+/* Exact circle/polygon test: the center inside, or an edge within r */
+static bool circle_overlaps(const Polygon *poly, f64 x, f64 y, f64 r)
+{
+    bool inside = true;
+    f64 nearest = INFINITY;
+    for (usize i = 0; i < poly->n; i++) {
+        f64 ax = scalar_to_f64(poly->points[i].x);
+        f64 ay = scalar_to_f64(poly->points[i].y);
+        f64 bx = scalar_to_f64(poly->points[(i + 1) % poly->n].x);
+        f64 by = scalar_to_f64(poly->points[(i + 1) % poly->n].y);
+        f64 ex = bx - ax;
+        f64 ey = by - ay;
+        inside = inside && ex * (y - ay) - ey * (x - ax) >= 0.0;
+        f64 t = fmin(fmax(((x - ax) * ex + (y - ay) * ey) / (ex * ex + ey * ey), 0.0), 1.0);
+        nearest = fmin(nearest, hypot(ax + t * ex - x, ay + t * ey - y));
+    }
+    return inside || nearest <= r;
+}
+
+/*
+ * Axis-aligned squares of side 20 offset along x or y, where GJK can stop
+ * on a segment through the inside of a - b, which random pairs never do.
+ * EPA must give 20 less the offset along the offset's direction. Returns
+ * how many are wrong.
+ */
+static usize check_aligned_penetration(void)
+{
+    static Vector2 square[2][4];
+    const f64 corners[4][2] = { { -10, -10 }, { 10, -10 }, { 10, 10 }, { -10, 10 } };
+    usize wrong = 0;
+    for (usize axis = 0; axis < 2; axis++) {
+        for (i32 k = -19; k <= 19; k++) {
+            if (k == 0) {
+                continue;
+            }
+            f64 dx = axis == 0 ? k : 0.0;
+            f64 dy = axis == 1 ? k : 0.0;
+            for (usize i = 0; i < 4; i++) {
+                square[0][i] = vec(corners[i][0], corners[i][1]);
+                square[1][i] = vec(corners[i][0] + dx, corners[i][1] + dy);
+            }
+            Polygon p1 = { .points = square[0], .n = 4 };
+            Polygon p2 = { .points = square[1], .n = 4 };
+            ConvexShape a = shape_polygon(&p1);
+            ConvexShape b = shape_polygon(&p2);
+            Penetration pen;
+            f64 sign = k > 0 ? 1.0 : -1.0;
+            wrong += !gjk_penetration(&a, &b, &pen) ||
+                     fabs(pen.depth - (20.0 - abs(k))) > 1e-9 ||
+                     fabs(pen.nx - (axis == 0 ? sign : 0.0)) > 1e-9 ||
+                     fabs(pen.ny - (axis == 1 ? sign : 0.0)) > 1e-9;
+        }
+    }
+    return wrong;
+}
+
+/*
+ * GJK against SAT on random convex pairs. Pairs that only touch, which
+ * come out differently when both shapes grow or shrink by 1e-4, are
+ * counted apart. Moving the second shape of a hit out along EPA's normal
+ * by its depth and a margin must separate the pair, and by the depth less
+ * the margin must not (tested by GJK, as 16.16 SAT rounds by more than
+ * the margin). Circles are checked against the exact distance, and EPA
+ * against exact depths, see check_aligned_penetration(). False on any
+ * real difference.
+ */
+static bool check_gjk(void)
+{
+    static Vector2 grown[2][CONVEX_MAX_POINTS];
+    static Vector2 shrunk[2][CONVEX_MAX_POINTS];
+    static Vector2 moved[CONVEX_MAX_POINTS];
+    const f64 margin = 1e-3;
+    usize pairs = 0, hits = 0, touching = 0, wrong = 0, epa_wrong = 0, circle_wrong = 0;
+    for (usize c = 0; c < sizeof(CONVEX_VERTEX_COUNTS) / sizeof(usize); c++) {
+        usize n = CONVEX_VERTEX_COUNTS[c];
+        for (usize round = 0; round < CONVEX_PAIRS / BENCH_SHAPES; round++) {
+            make_convex_pairs(n);
+            for (usize i = 0; i < BENCH_SHAPES; i++) {
+                Polygon *p1 = &convex[0][i];
+                Polygon *p2 = &convex[1][i];
+                ConvexShape a = shape_polygon(p1);
+                ConvexShape b = shape_polygon(p2);
+                bool sat = find_collision(p1, p2);
+                pairs += 1;
+                hits += sat;
+
+                // A circle on the first shape's first vertex against the second
+                f64 r = rand_f64(1.0, 40.0);
+                ConvexShape circle = shape_circle(&p1->points[0], r);
+                f64 cx = scalar_to_f64(p1->points[0].x);
+                f64 cy = scalar_to_f64(p1->points[0].y);
+                if (gjk_intersect(&circle, &b) != circle_overlaps(p2, cx, cy, r)) {
+                    bool near = circle_overlaps(p2, cx, cy, r * (1.0 + 1e-6)) !=
+                                circle_overlaps(p2, cx, cy, r * (1.0 - 1e-6));
+                    circle_wrong += !near;
+                }
+
+                if (sat != gjk_intersect(&a, &b)) {
+                    Polygon g1 = scaled_copy(p1, grown[0], 1.0 + 1e-4);
+                    Polygon g2 = scaled_copy(p2, grown[1], 1.0 + 1e-4);
+                    Polygon s1 = scaled_copy(p1, shrunk[0], 1.0 - 1e-4);
+                    Polygon s2 = scaled_copy(p2, shrunk[1], 1.0 - 1e-4);
+                    bool near = find_collision(&g1, &g2) && !find_collision(&s1, &s2);
+                    touching += near;
+                    wrong += !near;
+                    continue;
+                }
+                Penetration pen;
+                if (!sat || !gjk_penetration(&a, &b, &pen)) {
+                    continue;
+                }
+                f64 out = pen.depth + margin;
+                Polygon m = moved_copy(p2, moved, pen.nx * out, pen.ny * out);
+                epa_wrong += find_collision_gjk(p1, &m);
+                if (pen.depth > 2.0 * margin) {
+                    f64 in = pen.depth - margin;
+                    m = moved_copy(p2, moved, pen.nx * in, pen.ny * in);
+                    epa_wrong += !find_collision_gjk(p1, &m);
+                }
+            }
+        }
+    }
+    fprintf(stderr, "gjk: %lu random convex pairs, %lu hits, %lu only touching, "
+            "%lu differing from sat, %lu wrong penetrations, %lu wrong circles\n",
+            pairs, hits, touching, wrong, epa_wrong, circle_wrong);
+    usize aligned_wrong = check_aligned_penetration();
+    if (aligned_wrong) {
+        fprintf(stderr, "gjk: %lu wrong penetrations of axis-aligned squares\n", aligned_wrong);
+    }
+    return wrong == 0 && epa_wrong == 0 && circle_wrong == 0 && aligned_wrong == 0;
+}
+
+/* SAT and GJK on random convex pairs of n vertices, true if GJK is faster */
+static bool bench_convex(usize iterations, usize n)
+{
+    make_convex_pairs(n);
+    const usize mask = BENCH_SHAPES - 1;
+    BENCH("sat_random", n,
+        acc += find_collision(&convex[0][k & mask], &convex[1][k & mask]));
+    BENCH("gjk_random", n,
+        acc += find_collision_gjk(&convex[0][k & mask], &convex[1][k & mask]));
+    BENCH("epa_random", n, {
+        ConvexShape a = shape_polygon(&convex[0][k & mask]);
+        ConvexShape b = shape_polygon(&convex[1][k & mask]);
+        Penetration pen;
+        if (gjk_penetration(&a, &b, &pen)) {
+            acc += pen.depth;
+        }
+    });
+    f64 sat = results[num_results - 3].ns;
+    f64 gjk = results[num_results - 2].ns;
+    fprintf(stderr, "random convex pairs with %lu vertices: sat %.1f ns, gjk %.1f ns (%.2fx)\n",
+            n, sat, gjk, sat / gjk);
+    return gjk < sat;
+}
+
+static bool compare_baseline(const char *path, usize *regressions)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    f64 baseline[BENCH_MAX_RESULTS] = {0};
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char scalar[16], name[64];
+        usize n;
+        f64 ns;
+        if (sscanf(line, "%15[^,],%63[^,],%lu,%lf", scalar, name, &n, &ns) != 4) {
+            continue;
+        }
+        for (usize i = 0; i < num_results; i++) {
+            if (!strcmp(results[i].scalar, scalar) &&
+                !strcmp(results[i].name, name) && results[i].n == n) {
+                baseline[i] = ns;
+            }
+        }
+    }
+    fclose(file);
+
+    *regressions = 0;
+    printf("scalar,name,n,ns,baseline_ns,ratio\n");
+    for (usize i = 0; i < num_results; i++) {
+        const Result *r = &results[i];
+        f64 ratio = baseline[i] > 0.0 ? r->ns / baseline[i] : 0.0;
+        printf("%s,%s,%lu,%.3f,%.3f,%.3f\n",
+                r->scalar, r->name, r->n, r->ns, baseline[i], ratio);
+        *regressions += ratio > BENCH_TOLERANCE;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    usize iterations = argc > 1 ? strtoull(argv[1], NULL, 10) : 1 << 20;
+    const char *baseline = argc > 2 ? argv[2] : NULL;
+    if (iterations < 2) iterations = 2;
+
+    bench_vectors(iterations);
+    bench_trig(iterations);
+    bool exact = check_trig();
+    for (usize i = 0; i < sizeof(BENCH_VERTEX_COUNTS) / sizeof(usize); i++) {
+        bench_polygons(iterations, BENCH_VERTEX_COUNTS[i]);
+        bench_collisions(iterations, BENCH_VERTEX_COUNTS[i]);
+        if (poly_has_kernel(BENCH_VERTEX_COUNTS[i])) {
+            exact = check_kernels(BENCH_VERTEX_COUNTS[i]) && exact;
+        }
+    }
+    // The count from which GJK is faster at every count above it too
+    usize crossover = 0;
+    for (usize i = 0; i < sizeof(CONVEX_VERTEX_COUNTS) / sizeof(usize); i++) {
+        usize n = CONVEX_VERTEX_COUNTS[i];
+        if (!bench_convex(iterations / n > 2 ? iterations / n : 2, n)) {
+            crossover = 0;
+        } else if (!crossover) {
+            crossover = n;
+        }
+    }
+    if (crossover) {
+        fprintf(stderr, "gjk is faster than sat from %lu vertices\n", crossover);
+    } else {
+        fprintf(stderr, "sat is faster than gjk up to %d vertices\n", CONVEX_MAX_POINTS);
+    }
+    exact = check_gjk() && exact;
+    exact = check_short_edges() && exact;
+
+    if (!baseline) {
+        printf("scalar,name,n,ns\n");
+        for (usize i = 0; i < num_results; i++) {
+            const Result *r = &results[i];
+            printf("%s,%s,%lu,%.3f\n", r->scalar, r->name, r->n, r->ns);
+        }
+        return exact ? 0 : 1;
+    }
+    usize regressions;
+    if (!compare_baseline(baseline, &regressions)) {
+        fprintf(stderr, "Unable to open baseline %s\n", baseline);
+        return 1;
+    }
+    if (!exact) {
+        return 1;
+    }
+    if (regressions) {
+        fprintf(stderr, "%lu results slower than %.2fx the baseline\n",
+                regressions, BENCH_TOLERANCE);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "base.h"
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+#include "color.h"
+#include "raster.h"
+#include "jobs.h"
+#include "timer.h"
+
+/*
+ * Rendering throughput benchmark for the software rasterizer.
+ *
+ * Usage: raster_bench [frames] [polygons per frame] [max threads]
+ *
+ * The same scene is rendered with 1..max job threads (jobs.h). Every run must produce
+ * the same framebuffer hash, and with the default polygon count that hash
+ * must be GOLDEN_HASH, so a change to what the rasterizer draws fails here
+ * even when every thread count agrees.
+ */
+
+#define BENCH_MAX_POLYGONS 8192
+
+// Framebuffer hash of the default scene. The scene comes from rand(), so
+// this is for glibc. After changing the rasterizer's output on purpose,
+// look over a game_headless frame saved with HEADLESS_PPM, then set this
+// to the hash that raster_bench prints.
+#define GOLDEN_POLYGONS 1000
+#define GOLDEN_HASH 0x49a8bfb774a0a8b7
+
+static Polygon polygons[BENCH_MAX_POLYGONS];
+static Vector2 points[BENCH_MAX_POLYGONS][MAX_POINTS];
+static Color colors[BENCH_MAX_POLYGONS];
+
+static f64 rand_f64(f64 min, f64 max)
+{
+    return (max - min) * (f64) rand() / (f64) RAND_MAX + min;
+}
+
+static void make_scene(usize n)
+{
+    srand(1);
+    for (usize i = 0; i < n; i++) {
+        Polygon *poly = &polygons[i];
+        poly->points = points[i];
+        f64 r = rand_f64(5.0, 60.0);
+        Vector2 cent = vec(rand_f64(-WIDTH / 2.0, WIDTH / 2.0),
+                           rand_f64(-HEIGHT / 2.0, HEIGHT / 2.0));
+        poly->n = MAX_POINTS;
+        f64 theta = rand_f64(0.0, 2.0 * M_PI);
+        for (usize j = 0; j < poly->n; j++) {
+            poly->points[j] = vec_add(cent, vec_rotate(theta, vec(0.0, r)));
+            theta += 2.0 * M_PI / poly->n;
+        }
+        f64 grey = rand_f64(0.25, 0.75);
+        colors[i] = (Color) {
+            .r = grey, .g = grey, .b = grey,
+            .a = i % 4 ? 1.0 : rand_f64(0.0, 1.0),
+        };
+    }
+}
+
+int main(int argc, char **argv)
+{
+    usize frames = argc > 1 ? strtoull(argv[1], NULL, 10) : 100;
+    usize n = argc > 2 ? strtoull(argv[2], NULL, 10) : GOLDEN_POLYGONS;
+    usize max_threads = argc > 3 ? strtoull(argv[3], NULL, 10) : 4;
+    if (n > BENCH_MAX_POLYGONS) n = BENCH_MAX_POLYGONS;
+    make_scene(n);
+
+    const Color white = { .r = 1.0, .g = 1.0, .b = 1.0, .a = 1.0 };
+    u64 first = 0;
+    bool ok = true;
+    printf("threads\tpolygons/s\tMpix/s\tms/frame\thash\n");
+    for (usize threads = 1; threads <= max_threads; threads++) {
+        jobs_init(threads);
+        raster_init();
+        f64 start = timer_now();
+        for (usize f = 0; f < frames; f++) {
+            raster_clear(white);
+            for (usize i = 0; i < n; i++) {
+                raster_polygon(&polygons[i], colors[i]);
+            }
+            raster_flush();
+        }
+        f64 secs = timer_now() - start;
+        RasterStats stats = raster_stats();
+        u64 hash = raster_hash();
+        jobs_quit();
+
+        if (threads == 1) {
+            first = hash;
+        }
+        ok = ok && hash == first;
+        printf("%lu\t%.0f\t%.1f\t%.3f\t%016lx\n", threads,
+                stats.polygons / secs, stats.pixels / secs / 1e6,
+                1000.0 * secs / frames, hash);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Framebuffer differs between thread counts!\n");
+        return 1;
+    }
+    if (n == GOLDEN_POLYGONS && first != GOLDEN_HASH) {
+        fprintf(stderr, "Framebuffer hash %016lx, expected %016lx!\n", first, GOLDEN_HASH);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "base.h"
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+#include "color.h"
+#include "sdl_wrapper.h"
+
+/*
+ * Asteroid drawing benchmark for the SDL renderer.
+ *
+ * Usage: sprite_bench [frames] [asteroids]
+ *
+ * The same spinning asteroid field is drawn once as filled polygons and
+ * once through the sprite cache, and the per-frame CPU and GPU times of
+ * both runs are printed side by side.
+ */
+
+#define BENCH_MAX_ASTEROIDS 4096
+#define BENCH_SHAPES 32
+#define BENCH_SMALL_RAD 30.0
+#define BENCH_BIG_RAD 60.0
+
+static Polygon shapes[BENCH_SHAPES];
+static Vector2 shape_points[BENCH_SHAPES][MAX_POINTS];
+static Vector2 cents[BENCH_MAX_ASTEROIDS];
+static f64 omegas[BENCH_MAX_ASTEROIDS];
+static Color colors[BENCH_MAX_ASTEROIDS];
+
+static f64 rand_f64(f64 min, f64 max)
+{
+    return (max - min) * (f64) rand() / (f64) RAND_MAX + min;
+}
+
+static void make_scene(usize n)
+{
+    srand(1);
+    for (usize i = 0; i < BENCH_SHAPES; i++) {
+        Polygon *poly = &shapes[i];
+        poly->points = shape_points[i];
+        f64 r = i % 2 ? BENCH_BIG_RAD : BENCH_SMALL_RAD;
+        f64 theta = 0.0;
+        poly->n = ASTEROID_POINTS;
+        for (usize j = 0; j < poly->n; j++) {
+            f64 jitter = rand_f64(0.8, 1.0);
+            poly->points[j] = vec_rotate(theta, vec(0.0, r * jitter));
+            theta += 2.0 * M_PI / poly->n;
+        }
+    }
+    for (usize i = 0; i < n; i++) {
+        cents[i] = vec(rand_f64(-WIDTH / 2.0, WIDTH / 2.0),
+                       rand_f64(-HEIGHT / 2.0, HEIGHT / 2.0));
+        omegas[i] = rand_f64(-2.0, 2.0);
+        f64 grey = rand_f64(0.25, 0.75);
+        colors[i] = (Color) { .r = grey, .g = grey, .b = grey, .a = 1.0 };
+    }
+}
+
+static void run(usize frames, usize n, bool sprites, f64 *cpu, f64 *gpu)
+{
+    *cpu = 0.0;
+    *gpu = 0.0;
+    for (usize f = 0; f < frames; f++) {
+        sdl_clear();
+        for (usize i = 0; i < n; i++) {
+            usize shape = i % BENCH_SHAPES;
+            f64 theta = omegas[i] * f / 60.0;
+            Vector2 points[MAX_POINTS];
+            Polygon poly = { .points = points, .n = shapes[shape].n };
+            for (usize j = 0; j < poly.n; j++) {
+                Vector2 v = vec_rotate(theta, shapes[shape].points[j]);
+                poly.points[j] = vec_add(cents[i], v);
+            }
+            if (!sprites || !sdl_draw_sprite(shape + 1, &poly, cents[i], theta, colors[i])) {
+                sdl_draw_polygon(&poly, colors[i]);
+            }
+        }
+        sdl_show();
+        f64 c, g;
+        sdl_frame_times(&c, &g);
+        *cpu += c;
+        *gpu += g;
+    }
+    *cpu /= frames;
+    *gpu /= frames;
+}
+
+int main(int argc, char **argv)
+{
+    usize frames = argc > 1 ? strtoull(argv[1], NULL, 10) : 300;
+    usize n = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000;
+    if (n > BENCH_MAX_ASTEROIDS) n = BENCH_MAX_ASTEROIDS;
+    if (frames == 0) frames = 1;
+    make_scene(n);
+
+    sdl_init();
+    sdl_mute(true);
+    f64 cpu, gpu;
+    printf("mode\tcpu ms/frame\tgpu ms/frame\n");
+    run(frames, n, false, &cpu, &gpu);
+    printf("polygon\t%.3f\t%.3f\n", 1000.0 * cpu, 1000.0 * gpu);
+    run(frames, n, true, &cpu, &gpu);
+    printf("sprite\t%.3f\t%.3f\n", 1000.0 * cpu, 1000.0 * gpu);
+    sdl_quit();
+    return 0;
+}
@@ -1,12 +1,29 @@
+#include <stdatomic.h>
+#include <string.h>
+
 #include "base.h"
 #include "vector.h"
 #include "color.h"
 #include "const.h"
 #include "collision.h"
 #include "polygon.h"
+#include "trig.h"
+#include "vertex_arena.h"
+#include "scenario.h"
+#include "histogram.h"
+#include "memory_budget.h"
+#include "jobs.h"
+#include "physics.h"
 #include "sdl_wrapper.h"
+#include "capture.h"
+#include "state_export.h"
+#include "state_stream.h"
+#include "timer.h"
+#include "scale_controller.h"
+#include "quality_governor.h"
+#include "replay.h"
+#include "perf_counters.h"
 
-const usize PARTICLE_POINTS = 10;
 const usize NUM_PARTICLES = 10;
 const f64 PARTICLE_RAD = 1.0;
 const f64 PARTICLE_VEL = 50.0;
@@ -29,35 +46,64 @@ const f64 ASTEROID_RAD = 30.0;
 const f64 ASTEROID_VEL = 150.0;
 const usize INIT_NUM_ASTEROIDS = 5;
 const usize MAX_NUM_ASTEROIDS = 20;
+const f64 ASTEROID_DENSITY = 0.01;
+const f64 SLEEP_SPEED = 5.0;
+const u8 SLEEP_TICKS = 60;
+
+const u32 CAPTURE_FPS = 60;
+const u64 RNG_SEED = 0x853c49e6748fea9b;
+const f64 BENCH_DT = 1.0 / 60.0;
+const f64 FRAME_BUDGET = 1.0 / 60.0;
+const f64 MIN_RENDER_SCALE = 0.25;
+
+const f64 AUTOPILOT_AIM = 0.1;
+const f64 AUTOPILOT_RANGE = 250.0;
+const u64 AUTOPILOT_FIRE_TICKS = 8;
+const u64 SOAK_WINDOW = 600;
+const f64 LATENCY_BUCKET = 0.001;
+const usize TICK_GRAIN = 64;
+const usize PAIR_GRAIN = 256;
 
 const Vector2 MAX = {
-    .x = WIDTH / 2.0,
-    .y = HEIGHT / 2.0,
+    .x = SCALAR_C(WIDTH / 2.0),
+    .y = SCALAR_C(HEIGHT / 2.0),
 };
 const Vector2 MIN = {
-    .x = -WIDTH / 2.0,
-    .y = -HEIGHT / 2.0,
+    .x = SCALAR_C(-WIDTH / 2.0),
+    .y = SCALAR_C(-HEIGHT / 2.0),
 };
 const Color BLACK = { .r = 0.0, .g = 0.0, .b = 0.0, .a = 1.0 };
 const Color RED = { .r = 1.0, .g = 0.0, .b = 0.0, .a = 1.0 };
 
-f64 rand_f64(f64 min, f64 max)
+/*
+ * The random number generator state lives in GameState (xorshift64*), so
+ * restoring a snapshot also restores every future random draw.
+ */
+u32 rand_u32(u64 *rng)
+{
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return (*rng * 0x2545f4914f6cdd1d) >> 32;
+}
+
+f64 rand_f64(u64 *rng, f64 min, f64 max)
 {
-    return (max - min) * (f64) rand() / (f64) RAND_MAX + min;
+    return (max - min) * (f64) rand_u32(rng) / (f64) UINT32_MAX + min;
 }
 
-Vector2 rand_dir(void)
+Vector2 rand_dir(u64 *rng)
 {
-    f64 d = rand_f64(-1.0, 1.0);
+    f64 d = rand_f64(rng, -1.0, 1.0);
     Vector2 dir = {
         .x = d,
-        .y = (rand() % 2 ? -1.0 : 1.0) * sqrt(1.0 - d * d),
+        .y = (rand_u32(rng) % 2 ? -1.0 : 1.0) * sqrt(1.0 - d * d),
     };
     return dir;
 }
 
 typedef struct {
-    Polygon poly;
+    VertexRange verts;
     Color color;
     Vector2 cent;
     Vector2 v;
@@ -65,9 +111,12 @@ typedef struct {
     f64 theta;
     f64 omega;
     u8 health;
+    u8 still; // Ticks an asteroid has been slow, asleep at SLEEP_TICKS
+    u32 shape; // Sprite cache key of an asteroid's outline, never 0
 } Entity;
 
-typedef i8 EntityIndex;
+typedef i16 EntityIndex;
+_Static_assert(MAX_ENTITIES <= INT16_MAX, "EntityIndex holds i16 indices");
 
 typedef struct {
     EntityIndex idxs[MAX_ENTITIES];
@@ -88,11 +137,33 @@ typedef struct {
     bool turning_clockwise;
     bool turning_counterclockwise;
     bool shooting;
+    u8 quality; // Effects level, set between ticks like a control
+    f64 input_time; // Arrival of the oldest input not yet on screen, or 0
 } InputState;
 
+/*
+ * What each quality level keeps of the effects, level 0 being full
+ * quality. Only particles are turned down; the player, asteroids and
+ * bullets always collide and move exactly the same.
+ */
+typedef struct {
+    usize burst; // Particles per explosion at most
+    usize particle_points;
+    usize drawn_particles; // Newest particles drawn each frame
+} QualityLevel;
+
+const QualityLevel QUALITY_LEVELS[] = {
+    { .burst = 10, .particle_points = 10, .drawn_particles = MAX_ENTITIES },
+    { .burst = 6, .particle_points = 10, .drawn_particles = MAX_ENTITIES },
+    { .burst = 3, .particle_points = 4, .drawn_particles = 64 },
+    { .burst = 1, .particle_points = 4, .drawn_particles = 16 },
+};
+#define NUM_QUALITY_LEVELS (sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]))
+
 typedef struct {
     Entity entities[MAX_ENTITIES];
     bool free[MAX_ENTITIES];
+    VertexArena arena;
     EntityIndex player;
     EntityIndexArray asteroids;
     EntityIndexArray bullets;
@@ -100,7 +171,42 @@ typedef struct {
     InputState input;
     usize score;
     usize num_asteroids;
+    usize init_asteroids;
+    usize max_asteroids;
+    u64 tick;
+    u64 rng;
+    bool asteroid_contacts; // Asteroids bounce off each other
+    ContactCache contacts; // Impulses of the last tick's asteroid contacts
 } GameState;
+_Static_assert(sizeof(GameState) <= MEMORY_BUDGET_STATE, "GameState exceeds the state budget");
+
+/*
+ * The pools inside GameState. Their high water is taken from the state
+ * each tick starts from, outside the state so it never changes a hash.
+ */
+enum { ENTITY_POOL, INDEX_POOL, VERTEX_POOL, HOLE_POOL, CONTACT_CACHE_POOL, NUM_STATE_POOLS };
+static MemoryPool state_pools[NUM_STATE_POOLS] = {
+    [ENTITY_POOL] = { "entities", MAX_ENTITIES * (sizeof(Entity) + sizeof(bool)), MAX_ENTITIES, 0 },
+    // Asteroids, bullets and particles, the high water is the longest
+    [INDEX_POOL] = { "index arrays", 3 * sizeof(EntityIndexArray), MAX_ENTITIES, 0 },
+    [VERTEX_POOL] = { "arena vertices", ARENA_VERTICES * sizeof(Vector2), ARENA_VERTICES, 0 },
+    [HOLE_POOL] = { "arena holes", MAX_ENTITIES * sizeof(VertexRange), MAX_ENTITIES, 0 },
+    [CONTACT_CACHE_POOL] = { "contact cache", sizeof(ContactCache), MAX_CONTACTS, 0 },
+};
+
+void track_state_memory(const GameState *state)
+{
+    usize asteroids = state->asteroids.length;
+    usize bullets = state->bullets.length;
+    usize particles = state->particles.length;
+    memory_use(&state_pools[ENTITY_POOL], asteroids + bullets + particles + 1);
+    memory_use(&state_pools[INDEX_POOL], asteroids);
+    memory_use(&state_pools[INDEX_POOL], bullets);
+    memory_use(&state_pools[INDEX_POOL], particles);
+    memory_use(&state_pools[VERTEX_POOL], state->arena.high_water);
+    memory_use(&state_pools[HOLE_POOL], state->arena.free_length);
+    memory_use(&state_pools[CONTACT_CACHE_POOL], state->contacts.length);
+}
 
 void push(EntityIndexArray *arr, EntityIndex idx)
 {
@@ -135,28 +241,144 @@ EntityIndex alloc_entity(bool free[MAX_ENTITIES])
     return -1;
 }
 
+/*
+ * Separating axis hints of asteroid/bullet and player/asteroid pairs,
+ * direct mapped by entity handles: the slot and its generation, bumped
+ * when the slot is freed so a dead entity's entries never match again.
+ * An entry is one atomic word, the key above the axis, so job threads can
+ * share the cache, and a lost or stale entry only costs a full test. It
+ * is outside GameState since it never changes a result. Most pairs here
+ * separate on their first axis, where the lookup costs more than it
+ * saves, so it is off unless SAT_CACHE=1.
+ */
+#define SAT_AXIS_BITS 6
+_Static_assert(2 * MAX_POINTS + 2 < (1 << SAT_AXIS_BITS), "SatHint axis fits the entry");
+_Static_assert((SAT_CACHE_SLOTS & (SAT_CACHE_SLOTS - 1)) == 0, "SAT_CACHE_SLOTS is a power of two");
+
+static atomic_uint_fast64_t sat_cache[SAT_CACHE_SLOTS];
+static u16 entity_generations[MAX_ENTITIES];
+static SatStats sat_stats[JOBS_MAX_THREADS];
+static u64 sat_filled[JOBS_MAX_THREADS];
+static bool sat_caching = false;
+static NarrowPhase narrow_phase = NARROW_SAT;
+
+static MemoryPool sat_cache_pool = {
+    "sat cache", sizeof(sat_cache) + sizeof(entity_generations), SAT_CACHE_SLOTS, 0,
+};
+
 void free_entity(bool free[MAX_ENTITIES], EntityIndex idx)
 {
     free[idx] = true;
+    entity_generations[idx] += 1;
+}
+
+u64 pair_key(EntityIndex a, EntityIndex b)
+{
+    return 1ull << 56 | (u64) (entity_generations[a] & 0xfff) << 44 |
+           (u64) (entity_generations[b] & 0xfff) << 32 | (u64) a << 16 | (u64) b;
+}
+
+Polygon entity_poly(const GameState *state, const Entity *entity)
+{
+    return arena_poly(&state->arena, entity->verts);
+}
+
+/* Takes an entity slot and n vertices for its shape, -1 if either ran out */
+EntityIndex spawn_entity(GameState *state, usize n)
+{
+    EntityIndex idx = alloc_entity(state->free);
+    if (idx < 0) {
+        return -1;
+    }
+    if (!arena_alloc(&state->arena, n, &state->entities[idx].verts)) {
+        free_entity(state->free, idx);
+        return -1;
+    }
+    return idx;
 }
 
-void entity_translate(Entity *entity, Vector2 t)
+void despawn_entity(GameState *state, EntityIndex idx)
 {
-    poly_translate(&entity->poly, t);
+    arena_free(&state->arena, state->entities[idx].verts);
+    free_entity(state->free, idx);
+}
+
+/* Narrow phase of two entities, SAT warm started from their cached hint */
+bool collide_entities(const GameState *state, EntityIndex a, EntityIndex b, usize thread)
+{
+    Polygon poly_a = entity_poly(state, &state->entities[a]);
+    Polygon poly_b = entity_poly(state, &state->entities[b]);
+    if (!sat_caching || narrow_phase != NARROW_SAT) {
+        return narrow_collision(narrow_phase, &poly_a, &poly_b);
+    }
+    u64 key = pair_key(a, b);
+    atomic_uint_fast64_t *slot =
+        &sat_cache[(key * 0x9e3779b97f4a7c15 >> 32) & (SAT_CACHE_SLOTS - 1)];
+    u64 entry = atomic_load_explicit(slot, memory_order_relaxed);
+    SatHint hint = { .axis = SAT_NO_HINT };
+    if (entry >> SAT_AXIS_BITS == key) {
+        hint.axis = (i32) (entry & ((1 << SAT_AXIS_BITS) - 1)) - 2;
+    }
+    bool hit = find_collision_warm(&poly_a, &poly_b, &hint, &sat_stats[thread]);
+    u64 updated = key << SAT_AXIS_BITS | (u64) (hint.axis + 2);
+    if (updated != entry) {
+        u64 old = atomic_exchange_explicit(slot, updated, memory_order_relaxed);
+        sat_filled[thread] += old == 0;
+    }
+    return hit;
+}
+
+SatStats sat_cache_stats(void)
+{
+    SatStats total = {0};
+    for (usize t = 0; t < JOBS_MAX_THREADS; t++) {
+        total.tests += sat_stats[t].tests;
+        total.warm += sat_stats[t].warm;
+        total.hits += sat_stats[t].hits;
+        total.overlapping += sat_stats[t].overlapping;
+        total.axes += sat_stats[t].axes;
+        total.saved += sat_stats[t].saved;
+    }
+    return total;
+}
+
+void print_sat_stats(void)
+{
+    if (narrow_phase == NARROW_GJK) {
+        printf("narrow phase: gjk\n");
+        return;
+    }
+    if (!sat_caching) {
+        printf("sat cache: off\n");
+        return;
+    }
+    SatStats s = sat_cache_stats();
+    printf("sat cache: %lu tests, %.1f%% with a hint, %.1f%% of those still separated, "
+            "%.2f axes/test, %lu axis tests saved\n",
+            s.tests, s.tests ? 100.0 * s.warm / s.tests : 0.0,
+            s.warm ? 100.0 * s.hits / s.warm : 0.0,
+            s.tests ? (f64) s.axes / s.tests : 0.0, s.saved);
+}
+
+void entity_translate(GameState *state, Entity *entity, Vector2 t)
+{
+    Polygon poly = entity_poly(state, entity);
+    poly_translate(&poly, t);
     entity->cent = vec_add(entity->cent, t);
 }
 
-void entity_rotate(Entity *entity, f64 theta)
+void entity_rotate(GameState *state, Entity *entity, f64 theta)
 {
-    poly_rotate(&entity->poly, theta, entity->cent);
+    Polygon poly = entity_poly(state, entity);
+    poly_rotate(&poly, theta, entity->cent);
     entity->theta += theta;
 }
 
-void entity_tick(Entity *entity, f64 dt)
+void entity_tick(GameState *state, Entity *entity, f64 dt)
 {
     entity->v = vec_add(entity->v, vec_mul(dt, entity->a));
-    entity_translate(entity, vec_mul(dt, entity->v));
-    entity_rotate(entity, dt * entity->omega);
+    entity_translate(state, entity, vec_mul(dt, entity->v));
+    entity_rotate(state, entity, dt * entity->omega);
 }
 
 void spawn_asteroid_with_info(
@@ -167,75 +389,93 @@ void spawn_asteroid_with_info(
     Vector2 v,
     u8 health)
 {
-    EntityIndex idx = alloc_entity(state->free);
+    EntityIndex idx = spawn_entity(state, ASTEROID_POINTS);
     if (idx < 0) {
         return;
     }
     push(&state->asteroids, idx);
     state->num_asteroids += 1;
     Entity *entity = &state->entities[idx];
+    Polygon poly = entity_poly(state, entity);
     {
         f64 theta = 0.0;
         f64 steps[ASTEROID_POINTS];
         f64 sum = 0.0;
         for (usize i = 0; i < ASTEROID_POINTS; i++) {
-            steps[i] = rand_f64(0.0, 1.0);
+            steps[i] = rand_f64(&state->rng, 0.0, 1.0);
             sum += steps[i];
         }
         Vector2 v = vec(0.0, r);
         for (usize i = 0; i < ASTEROID_POINTS; i++) {
-            entity->poly.points[i] = vec_rotate(theta, v);
+            poly.points[i] = vec_rotate(theta, v);
             theta += 2.0 * M_PI * (steps[i] / sum);
         }
-        entity->poly.n = ASTEROID_POINTS;
     }
     entity->color = color;
-    entity->cent = poly_centroid(&entity->poly);
+    entity->cent = poly_centroid(&poly);
     {
         Vector2 t = vec_sub(cent, entity->cent);
-        entity_translate(entity, t);
+        entity_translate(state, entity, t);
     }
     entity->v = v;
     entity->a = vec(0.0, 0.0);
     entity->theta = 0.0;
     entity->omega = 0.0;
     entity->health = health;
+    entity->still = 0;
+    {
+        // FNV-1a over the outline relative to its centroid
+        u32 h = 2166136261u;
+        for (usize i = 0; i < poly.n; i++) {
+            Vector2 p = vec_sub(poly.points[i], entity->cent);
+            f64 xy[2] = { scalar_to_f64(p.x), scalar_to_f64(p.y) };
+            const u8 *bytes = (const u8 *) xy;
+            for (usize j = 0; j < sizeof(xy); j++) {
+                h = (h ^ bytes[j]) * 16777619u;
+            }
+        }
+        entity->shape = h ? h : 1;
+    }
 }
 
 void spawn_asteroid(GameState *state)
 {
-    const f64 i = rand_f64(MIN_GREY, MAX_GREY);
+    const f64 i = rand_f64(&state->rng, MIN_GREY, MAX_GREY);
     Color c = {.r = i, .g = i, .b = i, .a = 1.0 };
     f64 r;
     u8 health;
-    if (rand() % 2) {
+    if (rand_u32(&state->rng) % 2) {
         r = BIG_ASTEROID_RAD;
         health = 2;
     } else {
         r = ASTEROID_RAD;
         health = 1;
     }
+    f64 min_x = scalar_to_f64(MIN.x);
+    f64 min_y = scalar_to_f64(MIN.y);
+    f64 max_x = scalar_to_f64(MAX.x);
+    f64 max_y = scalar_to_f64(MAX.y);
     Vector2 cent;
-    switch(rand() % 4) {
+    switch(rand_u32(&state->rng) % 4) {
         case 0:
         {
-            cent = vec(MIN.x - r, rand_f64(MIN.y, MAX.y));
+            cent = vec(min_x - r, rand_f64(&state->rng, min_y, max_y));
         } break;
         case 1:
         {
-            cent = vec(MAX.x + r, rand_f64(MIN.y, MAX.y));
+            cent = vec(max_x + r, rand_f64(&state->rng, min_y, max_y));
         } break;
         case 2:
         {
-            cent = vec(rand_f64(MIN.x, MAX.x), MIN.y - r);
+            cent = vec(rand_f64(&state->rng, min_x, max_x), min_y - r);
         } break;
         case 3:
         {
-            cent = vec(rand_f64(MIN.x, MAX.x), MAX.y + r);
+            cent = vec(rand_f64(&state->rng, min_x, max_x), max_y + r);
         } break;
     }
-    spawn_asteroid_with_info(
-            state, r, c, cent, vec_mul(ASTEROID_VEL, rand_dir()), health);
+    Vector2 v = vec_mul(ASTEROID_VEL, rand_dir(&state->rng));
+    spawn_asteroid_with_info(state, r, c, cent, v, health);
 }
 
 void spawn_particles(
@@ -245,56 +485,64 @@ void spawn_particles(
     Color color,
     Vector2 cent)
 {
+    const QualityLevel *quality = &QUALITY_LEVELS[state->input.quality];
+    usize points = quality->particle_points;
+    if (n > quality->burst) {
+        n = quality->burst;
+    }
     for (usize i = 0; i < n; i++) {
-        EntityIndex idx = alloc_entity(state->free);
+        EntityIndex idx = spawn_entity(state, points);
         if (idx < 0) {
             return;
         }
         push(&state->particles, idx);
         Entity *particle = &state->entities[idx];
+        Polygon poly = entity_poly(state, particle);
         f64 theta = 0.0;
-        f64 step = 2.0 * M_PI / PARTICLE_POINTS;
+        f64 step = 2.0 * M_PI / points;
         Vector2 v = vec(0.0, PARTICLE_RAD);
-        for (usize i = 0; i < PARTICLE_POINTS; i++) {
-            particle->poly.points[i] = vec_rotate(theta, v);
+        for (usize i = 0; i < points; i++) {
+            poly.points[i] = vec_rotate(theta, v);
             theta += step;
         }
-        particle->poly.n = PARTICLE_POINTS;
         particle->color = color;
-        particle->cent = poly_centroid(&particle->poly);
-        entity_translate(particle,
-                vec_add(cent, vec_mul(rand_f64(0.0, 1.0) * r, rand_dir())));
-        particle->v = vec_mul(rand_f64(0.0, 1.0) * PARTICLE_VEL, rand_dir());
+        particle->cent = poly_centroid(&poly);
+        f64 offset = rand_f64(&state->rng, 0.0, 1.0) * r;
+        entity_translate(state, particle,
+                vec_add(cent, vec_mul(offset, rand_dir(&state->rng))));
+        f64 speed = rand_f64(&state->rng, 0.0, 1.0) * PARTICLE_VEL;
+        particle->v = vec_mul(speed, rand_dir(&state->rng));
         particle->a = vec(0.0, 0.0);
         particle->theta = 0.0;
         particle->omega = 0.0;
     }
 }
 
-void teleport(Entity *entity)
+void teleport(GameState *state, Entity *entity)
 {
-    Vector2 min = poly_min(&entity->poly);
-    Vector2 max = poly_max(&entity->poly);
+    Polygon poly = entity_poly(state, entity);
+    Vector2 min = poly_min(&poly);
+    Vector2 max = poly_max(&poly);
 
     if (max.x < MIN.x && entity->v.x < 0.0) {
 
-        Vector2 t = vec((MAX.x - MIN.x) + (max.x - min.x), 0.0);
-        entity_translate(entity, t);
+        Vector2 t = { (MAX.x - MIN.x) + (max.x - min.x), 0 };
+        entity_translate(state, entity, t);
 
     } else if (max.y < MIN.y && entity->v.y < 0.0) {
 
-        Vector2 t = vec(0.0, (MAX.y - MIN.y) + (max.y - min.y));
-        entity_translate(entity, t);
+        Vector2 t = { 0, (MAX.y - MIN.y) + (max.y - min.y) };
+        entity_translate(state, entity, t);
 
     } else if (min.x > MAX.x && entity->v.x > 0.0) {
 
-        Vector2 t = vec(-(MAX.x - MIN.x) - (max.x - min.x), 0.0);
-        entity_translate(entity, t);
+        Vector2 t = { -(MAX.x - MIN.x) - (max.x - min.x), 0 };
+        entity_translate(state, entity, t);
 
     } else if (min.y > MAX.y && entity->v.y > 0.0) {
 
-        Vector2 t = vec(0.0, -(MAX.y - MIN.y) - (max.y - min.y));
-        entity_translate(entity, t);
+        Vector2 t = { 0, -(MAX.y - MIN.y) - (max.y - min.y) };
+        entity_translate(state, entity, t);
     }
 }
 
@@ -303,28 +551,33 @@ void init_game(GameState *state)
     sdl_play_start();
 
     // Free all existing entities
+    for (usize i = 0; i < state->asteroids.length; i++) {
+        sdl_release_sprite(state->entities[state->asteroids.idxs[i]].shape);
+    }
     for (usize i = 0; i < MAX_ENTITIES; i++) {
         free_entity(state->free, i);
     }
+    arena_reset(&state->arena);
     clear(&state->asteroids);
     clear(&state->bullets);
     clear(&state->particles);
     state->num_asteroids = 0;
     state->score = 0;
+    state->contacts.length = 0;
 
     // Spawn player
     {
         // This EntityIndex must be valid because everything was just freed
-        state->player = alloc_entity(state->free);
+        state->player = spawn_entity(state, 4);
         Entity *player = &state->entities[state->player];
-        player->poly.points[0] = vec(PLAYER_PROP * PLAYER_LENGTH, 0.0);
-        player->poly.points[1] = vec(0.0, 0.5 * PLAYER_WIDTH);
-        player->poly.points[2] = vec(-(1 - PLAYER_PROP) * PLAYER_LENGTH, 0.0);
-        player->poly.points[3] = vec(0.0, -0.5 * PLAYER_WIDTH);
-        player->poly.n = 4;
+        Polygon poly = entity_poly(state, player);
+        poly.points[0] = vec(PLAYER_PROP * PLAYER_LENGTH, 0.0);
+        poly.points[1] = vec(0.0, 0.5 * PLAYER_WIDTH);
+        poly.points[2] = vec(-(1 - PLAYER_PROP) * PLAYER_LENGTH, 0.0);
+        poly.points[3] = vec(0.0, -0.5 * PLAYER_WIDTH);
         player->color = BLACK;
-        player->cent = poly_centroid(&player->poly);
-        entity_translate(player, vec_mul(-1.0, player->cent));
+        player->cent = poly_centroid(&poly);
+        entity_translate(state, player, vec_mul(-1.0, player->cent));
         player->v = vec(0.0, 0.0);
         player->a = vec(0.0, 0.0);
         player->theta = 0.0;
@@ -333,7 +586,7 @@ void init_game(GameState *state)
     }
 
     // Spawn asteroids
-    for (usize i = 0; i < INIT_NUM_ASTEROIDS; i++) {
+    for (usize i = 0; i < state->init_asteroids; i++) {
         spawn_asteroid(state);
     }
 
@@ -351,52 +604,442 @@ void init_game(GameState *state)
 }
 
 
+/*
+ * Parallel parts of update(). Each job only touches the entities at its
+ * own indices, which own disjoint arena ranges, so integration gives the
+ * same bits on any number of threads; anything that allocates, frees or
+ * draws random numbers stays serial.
+ */
+typedef struct {
+    GameState *state;
+    f64 dt;
+} TickJob;
+
+void tick_particles_job(void *aux, usize begin, usize end, usize thread)
+{
+    TickJob *job = aux;
+    (void) thread;
+    for (usize i = begin; i < end; i++) {
+        Entity *particle = &job->state->entities[job->state->particles.idxs[i]];
+        particle->color.a -= job->dt;
+        if (particle->color.a >= 0.0) {
+            entity_tick(job->state, particle, job->dt);
+        }
+    }
+}
+
+void tick_asteroids_job(void *aux, usize begin, usize end, usize thread)
+{
+    TickJob *job = aux;
+    (void) thread;
+    for (usize i = begin; i < end; i++) {
+        Entity *entity = &job->state->entities[job->state->asteroids.idxs[i]];
+        if (entity->still >= SLEEP_TICKS) {
+            continue;
+        }
+        teleport(job->state, entity);
+        entity_tick(job->state, entity, job->dt);
+    }
+}
+
+void tick_bullets_job(void *aux, usize begin, usize end, usize thread)
+{
+    TickJob *job = aux;
+    (void) thread;
+    for (usize i = begin; i < end; i++) {
+        entity_tick(job->state, &job->state->entities[job->state->bullets.idxs[i]], job->dt);
+    }
+}
+
+/*
+ * Asteroid/asteroid contacts through physics.h, with mass from the
+ * outline's area. An asteroid that stays slow on screen for SLEEP_TICKS
+ * falls asleep: it stops and is not integrated until an awake asteroid
+ * pushes it. Off screen they never sleep, so none is stranded out there.
+ */
+static Body bodies[MAX_ENTITIES];
+static PhysicsStats physics_stats;
+
+static MemoryPool body_pool = { "asteroid bodies", sizeof(bodies), MAX_ENTITIES, 0 };
+_Static_assert(sizeof(bodies) <= MEMORY_BUDGET_PHYSICS,
+        "asteroid bodies exceed the physics budget");
+
+bool on_screen(const Entity *entity)
+{
+    return entity->cent.x > MIN.x && entity->cent.x < MAX.x &&
+           entity->cent.y > MIN.y && entity->cent.y < MAX.y;
+}
+
+/*
+ * Bounce the asteroids on screen off each other. Those off screen keep
+ * the velocity they have, so none is ever stopped where it can't be seen.
+ */
+void collide_asteroids(GameState *state)
+{
+    usize n = 0;
+    for (usize i = 0; i < state->asteroids.length; i++) {
+        EntityIndex idx = state->asteroids.idxs[i];
+        Entity *asteroid = &state->entities[idx];
+        if (!on_screen(asteroid)) {
+            asteroid->still = 0;
+            continue;
+        }
+        Polygon poly = entity_poly(state, asteroid);
+        f64 area = fabs(wide_to_f64(poly_area(&poly)));
+        bodies[n++] = (Body) {
+            .id = idx,
+            .asleep = asteroid->still >= SLEEP_TICKS,
+            .poly = poly,
+            .inv_mass = area > 0.0 ? 1.0 / (ASTEROID_DENSITY * area) : 0.0,
+            .vx = scalar_to_f64(asteroid->v.x),
+            .vy = scalar_to_f64(asteroid->v.y),
+        };
+    }
+    memory_use(&body_pool, n);
+    physics_step(bodies, n, &state->contacts, &physics_stats);
+
+    for (usize i = 0; i < n; i++) {
+        const Body *body = &bodies[i];
+        Entity *asteroid = &state->entities[body->id];
+        if (body->asleep) {
+            continue;
+        }
+        if (body->dx != 0.0 || body->dy != 0.0) {
+            entity_translate(state, asteroid, vec(body->dx, body->dy));
+        }
+        bool shown = on_screen(asteroid);
+        f64 speed2 = body->vx * body->vx + body->vy * body->vy;
+        if (shown || speed2 >= SLEEP_SPEED * SLEEP_SPEED) {
+            asteroid->v = vec(body->vx, body->vy);
+        }
+        bool woken = asteroid->still >= SLEEP_TICKS;
+        if (woken || !shown || speed2 >= SLEEP_SPEED * SLEEP_SPEED) {
+            asteroid->still = 0;
+        } else if (++asteroid->still == SLEEP_TICKS) {
+            asteroid->v = vec(0.0, 0.0);
+        }
+    }
+}
+
+void print_physics_stats(const GameState *state)
+{
+    if (!state->asteroid_contacts) {
+        printf("asteroid contacts: off\n");
+        return;
+    }
+    const PhysicsStats *s = &physics_stats;
+    f64 steps = s->steps ? (f64) s->steps : 1.0;
+    printf("asteroid contacts: %.2f pairs, %.2f contacts (%.1f%% warm started), "
+            "%.2f batches, %.2f solved serially, %.3f woken per tick, %lu dropped\n",
+            s->pairs / steps, s->contacts / steps,
+            s->contacts ? 100.0 * s->warm / s->contacts : 0.0,
+            s->batches / steps, s->serial / steps, s->woken / steps, s->dropped);
+}
+
+/*
+ * Bullet/asteroid hits as pair numbers asteroid * bullets + bullet, over
+ * positions in the two arrays, so sorting them gives the order the nested
+ * serial loops would meet them in.
+ */
+#define MAX_THREAD_HITS MAX_ENTITIES
+
+static u32 thread_hits[JOBS_MAX_THREADS][MAX_THREAD_HITS];
+static usize thread_hit_counts[JOBS_MAX_THREADS];
+static bool thread_hits_full[JOBS_MAX_THREADS];
+static u32 merged_hits[JOBS_MAX_THREADS * MAX_THREAD_HITS];
+
+// With update()'s bullet scratch; the high water is the most hits one thread found
+static MemoryPool hit_pool = {
+    "hit buffers",
+    sizeof(thread_hits) + sizeof(merged_hits) + MAX_ENTITIES * (sizeof(EntityIndex) + sizeof(bool)),
+    MAX_THREAD_HITS,
+    0,
+};
+_Static_assert(sizeof(thread_hits) + sizeof(merged_hits) <= MEMORY_BUDGET_JOBS,
+        "hit buffers exceed the jobs budget");
+
+void find_hits_job(void *aux, usize begin, usize end, usize thread)
+{
+    const GameState *state = aux;
+    usize bullets = state->bullets.length;
+    for (usize p = begin; p < end; p++) {
+        EntityIndex asteroid = state->asteroids.idxs[p / bullets];
+        EntityIndex bullet = state->bullets.idxs[p % bullets];
+        if (collide_entities(state, asteroid, bullet, thread)) {
+            if (thread_hit_counts[thread] == MAX_THREAD_HITS) {
+                thread_hits_full[thread] = true;
+            } else {
+                thread_hits[thread][thread_hit_counts[thread]] = p;
+                thread_hit_counts[thread] += 1;
+            }
+        }
+    }
+}
+
+int compare_hits(const void *a, const void *b)
+{
+    u32 x = *(const u32 *) a;
+    u32 y = *(const u32 *) b;
+    return (x > y) - (x < y);
+}
+
+/* Test every bullet/asteroid pair into merged_hits, false if any were lost */
+bool find_hits(const GameState *state, usize *num_hits)
+{
+    usize threads = jobs_threads();
+    for (usize t = 0; t < threads; t++) {
+        thread_hit_counts[t] = 0;
+        thread_hits_full[t] = false;
+    }
+    usize pairs = state->asteroids.length * state->bullets.length;
+    jobs_parallel_for(pairs, PAIR_GRAIN, find_hits_job, (void *) state);
+
+    bool complete = true;
+    usize n = 0;
+    for (usize t = 0; t < threads; t++) {
+        memcpy(&merged_hits[n], thread_hits[t], thread_hit_counts[t] * sizeof(u32));
+        n += thread_hit_counts[t];
+        memory_use(&hit_pool, thread_hit_counts[t]);
+        complete = complete && !thread_hits_full[t];
+    }
+    qsort(merged_hits, n, sizeof(u32), compare_hits);
+    *num_hits = n;
+    return complete;
+}
+
+/* Bullet j hit asteroid i: score it, split or replace it, remove both */
+void resolve_hit(GameState *state, usize i, usize j)
+{
+    EntityIndex asteroid_idx = state->asteroids.idxs[i];
+    EntityIndex bullet_idx = state->bullets.idxs[j];
+    Entity *asteroid = &state->entities[asteroid_idx];
+    sdl_play_hit();
+    asteroid->health -= 1;
+    state->num_asteroids -= 1;
+    if (asteroid->health == 0) {
+        state->score += 10;
+        spawn_particles(
+            state, NUM_PARTICLES, ASTEROID_RAD, asteroid->color, asteroid->cent);
+        if (state->num_asteroids < state->max_asteroids) {
+            spawn_asteroid(state);
+        }
+    } else {
+        state->score += 5;
+        spawn_asteroid_with_info(
+            state,
+            ASTEROID_RAD,
+            asteroid->color,
+            vec_add(asteroid->cent, vec(ASTEROID_RAD, 0.0)),
+            vec_mul(ASTEROID_VEL, rand_dir(&state->rng)),
+            1);
+        spawn_asteroid_with_info(
+            state,
+            ASTEROID_RAD,
+            asteroid->color,
+            vec_sub(asteroid->cent, vec(ASTEROID_RAD, 0.0)),
+            vec_mul(ASTEROID_VEL, rand_dir(&state->rng)),
+            1);
+    }
+    despawn_entity(state, bullet_idx);
+    remove_index(&state->bullets, j);
+    sdl_release_sprite(asteroid->shape);
+    despawn_entity(state, asteroid_idx);
+    remove_index(&state->asteroids, i);
+}
+
+f64 steering_omega(const InputState *input)
+{
+    if (input->turning_clockwise == input->turning_counterclockwise) {
+        return 0.0;
+    }
+    return input->turning_clockwise ? -PLAYER_OMEGA : PLAYER_OMEGA;
+}
+
+/*
+ * Phases of update() and render(), timed when phase_timing is set and
+ * counted by the hardware counters too when they are open (PERF_COUNTERS,
+ * perf_counters.h). phase_times has the last time of each phase and
+ * phase_totals the sums since phase_reset(), all outside the state.
+ */
+typedef enum {
+    PHASE_PARTICLES,
+    PHASE_CONTACTS,
+    PHASE_ASTEROIDS,
+    PHASE_BULLETS,
+    PHASE_PLAYER,
+    PHASE_HITS,
+    NUM_UPDATE_PHASES,
+    PHASE_CLEAR = NUM_UPDATE_PHASES,
+    PHASE_DRAW_PARTICLES,
+    PHASE_DRAW_ASTEROIDS,
+    PHASE_DRAW_BULLETS,
+    PHASE_DRAW_PLAYER,
+    PHASE_PRESENT,
+    NUM_PHASES,
+} Phase;
+
+const char *PHASE_NAMES[NUM_PHASES] = {
+    "particles", "contacts", "asteroids", "bullets", "player", "hits",
+    "clear", "draw particles", "draw asteroids", "draw bullets", "draw player", "present",
+};
+
+typedef struct {
+    f64 seconds;
+    u64 counts[NUM_COUNTERS];
+} PhaseTotal;
+
+static bool phase_timing = false;
+static f64 phase_times[NUM_PHASES];
+static PhaseTotal phase_totals[NUM_PHASES];
+static u64 phase_frames; // Updates in phase_totals
+static f64 phase_mark;
+static CounterValues phase_mark_counts;
+
+void phase_reset(void)
+{
+    memset(phase_totals, 0, sizeof(phase_totals));
+    phase_frames = 0;
+}
+
+static inline void phase_start(void)
+{
+    if (phase_timing) {
+        counters_read(&phase_mark_counts);
+        phase_mark = timer_now();
+    }
+}
+
+/* Close phase at the current time and start the next one */
+static inline void phase_end(Phase phase)
+{
+    if (phase_timing) {
+        f64 now = timer_now();
+        CounterValues counts;
+        counters_read(&counts);
+        u64 deltas[NUM_COUNTERS];
+        counters_scale(&phase_mark_counts, &counts, deltas);
+        PhaseTotal *total = &phase_totals[phase];
+        phase_times[phase] = now - phase_mark;
+        total->seconds += now - phase_mark;
+        for (usize c = 0; c < NUM_COUNTERS; c++) {
+            total->counts[c] += deltas[c];
+        }
+        phase_mark = now;
+        phase_mark_counts = counts;
+    }
+}
+
+static void print_phase_row(const char *name, const PhaseTotal *total)
+{
+    f64 frames = (f64) phase_frames;
+    printf("%-15s %9.2f", name, 1e6 * total->seconds / frames);
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        if (counter_available(c)) {
+            printf(" %13.0f", total->counts[c] / frames);
+        } else {
+            printf(" %13s", "n/a");
+        }
+    }
+    if (counter_available(COUNTER_CYCLES) && counter_available(COUNTER_INSTRUCTIONS) &&
+        total->counts[COUNTER_CYCLES] > 0) {
+        printf(" %5.2f", (f64) total->counts[COUNTER_INSTRUCTIONS] / total->counts[COUNTER_CYCLES]);
+    } else {
+        printf(" %5s", "n/a");
+    }
+    printf("\n");
+}
+
+/* Mean time and counts per frame of each phase since phase_reset() */
+void print_phase_stats(void)
+{
+    if (phase_frames == 0) {
+        return;
+    }
+    printf("%-15s %9s", "phase", "us/frame");
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        printf(" %13s", COUNTER_NAMES[c]);
+    }
+    printf(" %5s\n", "IPC");
+    PhaseTotal frame = { 0 };
+    for (usize p = 0; p < NUM_PHASES; p++) {
+        const PhaseTotal *total = &phase_totals[p];
+        if (total->seconds == 0.0) {
+            continue;
+        }
+        print_phase_row(PHASE_NAMES[p], total);
+        frame.seconds += total->seconds;
+        for (usize c = 0; c < NUM_COUNTERS; c++) {
+            frame.counts[c] += total->counts[c];
+        }
+    }
+    print_phase_row("frame", &frame);
+    if (!counters_active()) {
+        printf("hardware counters unavailable (%s), times only\n", counters_error());
+    } else if (counters_error()) {
+        printf("some hardware counters unavailable (%s)\n", counters_error());
+    }
+    if (counters_active() && jobs_threads() > 1) {
+        printf("counters cover the main thread, not the other %lu job threads\n",
+                jobs_threads() - 1);
+    }
+}
+
 void update(GameState *state, f64 dt)
 {
+    track_state_memory(state);
+    state->tick += 1;
+    if (phase_timing) {
+        memset(phase_times, 0, NUM_UPDATE_PHASES * sizeof(f64));
+        phase_frames += 1;
+        phase_start();
+    }
+
     if (state->input.restarting) {
         init_game(state);
         return;
     }
 
+    TickJob job = { .state = state, .dt = dt };
+
     // Update particles
+    jobs_parallel_for(state->particles.length, TICK_GRAIN, tick_particles_job, &job);
     for (usize i = 0; i < state->particles.length; i++) {
         EntityIndex idx = state->particles.idxs[i];
-        Entity *particle = &state->entities[idx];
-        particle->color.a -= dt;
-        if (particle->color.a < 0.0) {
-            free_entity(state->free, idx);
+        if (state->entities[idx].color.a < 0.0) {
+            despawn_entity(state, idx);
             remove_index(&state->particles, i);
             i--;
-        } else {
-            entity_tick(particle, dt);
         }
     }
+    phase_end(PHASE_PARTICLES);
 
-    // Update asteroids
-    for (usize i = 0; i < state->asteroids.length; i++) {
-        Entity *entity = &state->entities[state->asteroids.idxs[i]];
-        teleport(entity);
-        entity_tick(entity, dt);
+    // Update asteroids, after bouncing them off each other
+    if (state->asteroid_contacts) {
+        collide_asteroids(state);
     }
+    phase_end(PHASE_CONTACTS);
+    jobs_parallel_for(state->asteroids.length, TICK_GRAIN, tick_asteroids_job, &job);
+    phase_end(PHASE_ASTEROIDS);
 
     // Update bullets
+    jobs_parallel_for(state->bullets.length, TICK_GRAIN, tick_bullets_job, &job);
     for (usize i = 0; i < state->bullets.length; i++) {
         EntityIndex idx = state->bullets.idxs[i];
         Entity *bullet = &state->entities[idx];
-        entity_tick(bullet, dt);
-
-        Vector2 min = poly_min(&bullet->poly);
-        Vector2 max = poly_max(&bullet->poly);
+        Polygon poly = entity_poly(state, bullet);
+        Vector2 min = poly_min(&poly);
+        Vector2 max = poly_max(&poly);
         if ((max.x < MIN.x && bullet->v.x < 0.0) ||
             (max.y < MIN.y && bullet->v.y < 0.0) ||
             (min.x > MAX.x && bullet->v.x > 0.0) ||
             (min.y > MAX.y && bullet->v.y > 0.0))
         {
-            free_entity(state->free, idx);
+            despawn_entity(state, idx);
             remove_index(&state->bullets, i);
             i--;
         }
     }
+    phase_end(PHASE_BULLETS);
 
     if (state->input.status == PLAYING) {
         Entity *player = &state->entities[state->player];
@@ -404,42 +1047,38 @@ void update(GameState *state, f64 dt)
         // Update player
         {
             player->a = vec_mul(-DRAG, player->v);
-            teleport(player);
+            teleport(state, player);
             if (state->input.thrusting) {
-                Vector2 dir = vec(cos(player->theta), sin(player->theta));
-                player->a = vec_add(player->a, vec_mul(THRUST, dir));
-            }
-            if (state->input.turning_clockwise && state->input.turning_counterclockwise) {
-                player->omega = 0.0;
-            } else if (state->input.turning_clockwise) {
-                player->omega = -PLAYER_OMEGA;
-            } else if (state->input.turning_counterclockwise) {
-                player->omega = PLAYER_OMEGA;
-            } else {
-                player->omega = 0.0;
+                f64 s, c;
+                trig_sincos(player->theta, &s, &c);
+                player->a = vec_add(player->a, vec_mul(THRUST, vec(c, s)));
             }
-            entity_tick(player, dt);
+            player->omega = steering_omega(&state->input);
+            entity_tick(state, player, dt);
         }
 
         // Spawn bullets
         if (state->input.shooting) {
             sdl_play_shoot();
-            EntityIndex idx = alloc_entity(state->free);
+            EntityIndex idx = spawn_entity(state, BULLET_POINTS);
             if (idx >= 0) {
                 push(&state->bullets, idx);
                 Entity *bullet = &state->entities[idx];
+                Polygon poly = entity_poly(state, bullet);
                 f64 theta = 0.0;
                 f64 step = 2.0 * M_PI / BULLET_POINTS;
                 Vector2 v = vec(0.0, BULLET_RAD);
                 for (usize i = 0; i < BULLET_POINTS; i++) {
-                    bullet->poly.points[i] = vec_rotate(theta, v);
+                    poly.points[i] = vec_rotate(theta, v);
                     theta += step;
                 }
-                bullet->poly.n = BULLET_POINTS;
                 bullet->color = RED;
-                bullet->cent = poly_centroid(&bullet->poly);
-                Vector2 dir = vec(cos(player->theta), sin(player->theta));
-                entity_translate(bullet, vec_add(player->cent, vec_mul(PLAYER_LENGTH / 2.0, dir)));
+                bullet->cent = poly_centroid(&poly);
+                f64 s, c;
+                trig_sincos(player->theta, &s, &c);
+                Vector2 dir = vec(c, s);
+                entity_translate(state, bullet,
+                        vec_add(player->cent, vec_mul(PLAYER_LENGTH / 2.0, dir)));
                 bullet->v = vec_mul(BULLET_VEL, dir);
                 bullet->a = vec(0.0, 0.0);
                 bullet->theta = 0.0;
@@ -454,7 +1093,7 @@ void update(GameState *state, f64 dt)
             EntityIndex idx = state->asteroids.idxs[i];
             Entity *asteroid = &state->entities[idx];
 
-            if (find_collision(&player->poly, &asteroid->poly)) {
+            if (collide_entities(state, state->player, idx, 0)) {
                 sdl_play_hit();
                 sdl_play_game_over();
                 state->num_asteroids -= 1;
@@ -463,100 +1102,473 @@ void update(GameState *state, f64 dt)
                 spawn_particles(
                     state, NUM_PARTICLES, ASTEROID_RAD, asteroid->color, asteroid->cent);
                 state->input.status = OVER;
-                free_entity(state->free, idx);
+                sdl_release_sprite(asteroid->shape);
+                despawn_entity(state, idx);
                 remove_index(&state->asteroids, i);
                 i--;
             }
         }
     }
-
-    // Find bullet/asteroid collisions
-    for (usize i = 0; i < state->asteroids.length; i++) {
-        for (usize j = 0; j < state->bullets.length; j++) {
-            EntityIndex asteroid_idx = state->asteroids.idxs[i];
-            EntityIndex bullet_idx = state->bullets.idxs[j];
-            Entity *asteroid = &state->entities[asteroid_idx];
-            Polygon *asteroid_poly = &state->entities[asteroid_idx].poly;
-            Polygon *bullet_poly = &state->entities[bullet_idx].poly;
-
-            if (find_collision(asteroid_poly, bullet_poly)) {
-                sdl_play_hit();
-                asteroid->health -= 1;
-                state->num_asteroids -= 1;
-                if (asteroid->health == 0) {
-                    state->score += 10;
-                    spawn_particles(
-                        state, NUM_PARTICLES, ASTEROID_RAD, asteroid->color, asteroid->cent);
-                    if (state->num_asteroids < MAX_NUM_ASTEROIDS) {
-                        spawn_asteroid(state);
-                    }
-                } else {
-                    state->score += 5;
-                    spawn_asteroid_with_info(
-                        state,
-                        ASTEROID_RAD,
-                        asteroid->color,
-                        vec_add(asteroid->cent, vec(ASTEROID_RAD, 0.0)),
-                        vec_mul(ASTEROID_VEL, rand_dir()),
-                        1);
-                    spawn_asteroid_with_info(
-                        state,
-                        ASTEROID_RAD,
-                        asteroid->color,
-                        vec_sub(asteroid->cent, vec(ASTEROID_RAD, 0.0)),
-                        vec_mul(ASTEROID_VEL, rand_dir()),
-                        1);
+    phase_end(PHASE_PLAYER);
+
+    // Find bullet/asteroid collisions. The pairs alive now are tested in
+    // parallel and resolved in the serial order, where each asteroid takes
+    // the first live bullet that hits it. Asteroids spawned while
+    // resolving are tested as they come, as are all of them if a thread's
+    // hit buffer overflowed.
+    usize asteroids = state->asteroids.length;
+    usize bullets = state->bullets.length;
+    usize num_hits;
+    usize first_unchecked = 0;
+    if (find_hits(state, &num_hits)) {
+        static EntityIndex bullet_idxs[MAX_ENTITIES];
+        static bool spent[MAX_ENTITIES];
+        memcpy(bullet_idxs, state->bullets.idxs, bullets * sizeof(EntityIndex));
+        memset(spent, 0, bullets * sizeof(bool));
+        usize removed = 0;
+        usize h = 0;
+        for (usize a = 0; a < asteroids; a++) {
+            bool found = false;
+            usize b = 0;
+            for (; h < num_hits && merged_hits[h] / bullets == a; h++) {
+                if (!found && !spent[merged_hits[h] % bullets]) {
+                    found = true;
+                    b = merged_hits[h] % bullets;
                 }
-                free_entity(state->free, bullet_idx);
-                remove_index(&state->bullets, j);
-                j--;
-                free_entity(state->free, asteroid_idx);
-                remove_index(&state->asteroids, i);
+            }
+            if (found) {
+                spent[b] = true;
+                usize j = 0;
+                while (state->bullets.idxs[j] != bullet_idxs[b]) {
+                    j++;
+                }
+                resolve_hit(state, a - removed, j);
+                removed += 1;
+            }
+        }
+        first_unchecked = asteroids - removed;
+    }
+    for (usize i = first_unchecked; i < state->asteroids.length; i++) {
+        for (usize j = 0; j < state->bullets.length; j++) {
+            if (collide_entities(state, state->asteroids.idxs[i], state->bullets.idxs[j], 0)) {
+                resolve_hit(state, i, j);
                 i--;
                 break;
             }
         }
     }
+    phase_end(PHASE_HITS);
+}
+
+/*
+ * Ring of the last ROLLBACK_TICKS states and the inputs that were applied
+ * to them. GameState holds no pointers, so a snapshot is a single memcpy,
+ * and it holds the random number generator, so resimulating from a
+ * snapshot with the same inputs reproduces the same ticks exactly.
+ */
+typedef struct {
+    InputState input;
+    f64 dt;
+} TickInput;
+
+typedef struct {
+    GameState states[ROLLBACK_TICKS];
+    TickInput inputs[ROLLBACK_TICKS];
+    u64 newest;
+    usize length;
+} Rollback;
+_Static_assert(sizeof(Rollback) <= MEMORY_BUDGET_ROLLBACK, "Rollback exceeds the rollback budget");
+
+static MemoryPool rollback_pool = { "rollback ring", sizeof(Rollback), ROLLBACK_TICKS, 0 };
+
+/* Only the controls are inputs; status is written by update() itself */
+void apply_controls(InputState *dst, const InputState *src)
+{
+    dst->restarting = src->restarting;
+    dst->thrusting = src->thrusting;
+    dst->turning_clockwise = src->turning_clockwise;
+    dst->turning_counterclockwise = src->turning_counterclockwise;
+    dst->shooting = src->shooting;
+    dst->quality = src->quality;
+}
+
+/* Record the state at state->tick and the dt about to be applied to it */
+void rollback_save(Rollback *rb, const GameState *state, f64 dt)
+{
+    usize slot = state->tick % ROLLBACK_TICKS;
+    memcpy(&rb->states[slot], state, sizeof(GameState));
+    rb->inputs[slot].input = state->input;
+    rb->inputs[slot].dt = dt;
+    if (rb->length > 0 && state->tick != rb->newest + 1) {
+        rb->length = 0;
+    }
+    rb->newest = state->tick;
+    if (rb->length < ROLLBACK_TICKS) {
+        rb->length += 1;
+    }
+    memory_use(&rollback_pool, rb->length);
+}
+
+bool rollback_has(const Rollback *rb, u64 tick)
+{
+    return rb->length > 0 && tick <= rb->newest && rb->newest - tick < rb->length;
+}
+
+void rollback_restore(const Rollback *rb, GameState *state, u64 tick)
+{
+    assert(rollback_has(rb, tick));
+    memcpy(state, &rb->states[tick % ROLLBACK_TICKS], sizeof(GameState));
+}
+
+/*
+ * Replace the controls recorded for tick onward with the ones that were
+ * actually pressed. Held keys stay held for every later recorded tick,
+ * while a shot or restart only happens at tick itself.
+ */
+void rollback_correct(Rollback *rb, u64 tick, const InputState *input)
+{
+    for (u64 t = tick; rollback_has(rb, t); t++) {
+        InputState *recorded = &rb->inputs[t % ROLLBACK_TICKS].input;
+        bool shooting = recorded->shooting;
+        bool restarting = recorded->restarting;
+        apply_controls(recorded, input);
+        if (t != tick) {
+            recorded->shooting = shooting;
+            recorded->restarting = restarting;
+        }
+    }
+}
+
+/*
+ * Roll state back to tick and run the recorded inputs forward to the tick
+ * it was at, refreshing the snapshots along the way. Returns the number of
+ * ticks resimulated, or zero if tick is no longer held.
+ */
+usize rollback_resimulate(Rollback *rb, GameState *state, u64 tick)
+{
+    u64 present = state->tick;
+    if (!rollback_has(rb, tick) || tick > present) {
+        return 0;
+    }
+    sdl_mute(true);
+    rollback_restore(rb, state, tick);
+    while (state->tick < present) {
+        TickInput in = rb->inputs[state->tick % ROLLBACK_TICKS];
+        apply_controls(&state->input, &in.input);
+        rollback_save(rb, state, in.dt);
+        update(state, in.dt);
+    }
+    sdl_mute(false);
+    return present - tick;
+}
+
+/* FNV-1a hash of the whole state, for checking determinism */
+u64 state_hash(const GameState *state)
+{
+    const u8 *bytes = (const u8 *) state;
+    u64 hash = 0xcbf29ce484222325;
+    for (usize i = 0; i < sizeof(GameState); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+/* Fixed input pattern used by benchmarks: turn, thrust, shoot, restart */
+void script_input(InputState *input, u64 tick)
+{
+    if (input->status == OVER) {
+        input->restarting = true;
+        return;
+    }
+    input->thrusting = tick % 240 < 60;
+    input->turning_counterclockwise = tick % 180 < 90;
+    input->turning_clockwise = false;
+    input->shooting = tick % 15 == 0;
+}
+
+/*
+ * Plays for soak runs: turns toward the nearest asteroid, fires while
+ * lined up with it and thrusts to close in when it is far away.
+ */
+void autopilot(const GameState *state, InputState *input)
+{
+    if (input->status == OVER) {
+        input->restarting = true;
+        return;
+    }
+    const Entity *player = &state->entities[state->player];
+    f64 px = scalar_to_f64(player->cent.x);
+    f64 py = scalar_to_f64(player->cent.y);
+    f64 nearest = INFINITY;
+    f64 angle = 0.0;
+    for (usize i = 0; i < state->asteroids.length; i++) {
+        const Entity *asteroid = &state->entities[state->asteroids.idxs[i]];
+        f64 dx = scalar_to_f64(asteroid->cent.x) - px;
+        f64 dy = scalar_to_f64(asteroid->cent.y) - py;
+        f64 dist = sqrt(dx * dx + dy * dy);
+        if (dist < nearest) {
+            nearest = dist;
+            angle = remainder(atan2(dy, dx) - player->theta, 2.0 * M_PI);
+        }
+    }
+    bool target = nearest < INFINITY;
+    input->turning_counterclockwise = target && angle > AUTOPILOT_AIM;
+    input->turning_clockwise = target && angle < -AUTOPILOT_AIM;
+    input->thrusting = target && nearest > AUTOPILOT_RANGE;
+    input->shooting = target && fabs(angle) < 2.0 * AUTOPILOT_AIM &&
+        state->tick % AUTOPILOT_FIRE_TICKS == 0;
+}
+
+/*
+ * Time snapshots, restores and resimulation over the ring, then correct
+ * the controls at a tick in the middle of the ring and check that
+ * resimulating reaches the state of a straight run fed the corrected
+ * controls from the start. False if either check fails.
+ */
+bool rollback_bench(GameState *state, usize ticks, usize rounds)
+{
+    static Rollback rb;
+    static GameState straight;
+    static TickInput recorded[ROLLBACK_TICKS];
+    sdl_mute(true);
+    memcpy(&straight, state, sizeof(GameState));
+
+    f64 save_time = 0.0;
+    for (usize i = 0; i < ticks; i++) {
+        script_input(&state->input, state->tick);
+        f64 start = timer_now();
+        rollback_save(&rb, state, BENCH_DT);
+        save_time += timer_now() - start;
+        update(state, BENCH_DT);
+    }
+    u64 present = state->tick;
+    u64 hash = state_hash(state);
+
+    f64 restore_time = 0.0;
+    f64 resim_time = 0.0;
+    usize resim_ticks = 0;
+    bool deterministic = true;
+    for (usize i = 0; i < rounds; i++) {
+        u64 tick = rb.newest - (rb.length - 1);
+        f64 start = timer_now();
+        rollback_restore(&rb, state, tick);
+        restore_time += timer_now() - start;
+        state->tick = present;
+
+        start = timer_now();
+        resim_ticks += rollback_resimulate(&rb, state, tick);
+        resim_time += timer_now() - start;
+        deterministic = deterministic && state_hash(state) == hash;
+    }
+
+    // Turn the other way, thrust the opposite and shoot from tick on
+    u64 tick = rb.newest - rb.length / 2;
+    memcpy(recorded, rb.inputs, sizeof(recorded));
+    InputState correction = recorded[tick % ROLLBACK_TICKS].input;
+    correction.thrusting = !correction.thrusting;
+    correction.turning_clockwise = !correction.turning_clockwise;
+    correction.turning_counterclockwise = !correction.turning_counterclockwise;
+    correction.shooting = true;
+    rollback_correct(&rb, tick, &correction);
+    usize corrected_ticks = rollback_resimulate(&rb, state, tick);
+    u64 corrected_hash = state_hash(state);
+
+    // The held keys carry on and shots and restarts stay as they were
+    while (straight.tick < present) {
+        if (straight.tick < tick) {
+            script_input(&straight.input, straight.tick);
+        } else {
+            InputState input = recorded[straight.tick % ROLLBACK_TICKS].input;
+            if (straight.tick == tick) {
+                input = correction;
+            } else {
+                input.thrusting = correction.thrusting;
+                input.turning_clockwise = correction.turning_clockwise;
+                input.turning_counterclockwise = correction.turning_counterclockwise;
+                input.quality = correction.quality;
+            }
+            apply_controls(&straight.input, &input);
+        }
+        update(&straight, BENCH_DT);
+    }
+    bool corrected = state_hash(&straight) == corrected_hash && corrected_hash != hash;
+
+    f64 ticks_per_ms = resim_ticks / (1000.0 * resim_time);
+    printf("snapshot size: %lu bytes (%lu KiB ring of %d)\n",
+            sizeof(GameState), sizeof(Rollback) / 1024, ROLLBACK_TICKS);
+    printf("snapshot save: %.0f ns, restore: %.0f ns\n",
+            1e9 * save_time / ticks, 1e9 * restore_time / rounds);
+    printf("resimulation: %.1f ticks/ms, %.0f ticks per frame budget\n",
+            ticks_per_ms, ticks_per_ms * 1000.0 * FRAME_BUDGET);
+    printf("resimulation is %s\n", deterministic ? "deterministic" : "NOT deterministic");
+    printf("correction at tick %lu: %lu ticks resimulated, state hash %016lx, %s\n",
+            tick, corrected_ticks, corrected_hash,
+            corrected ? "matches a straight run" : "DIFFERS from a straight run");
+    sdl_mute(false);
+    return deterministic && corrected;
+}
+
+void tick_bench(GameState *state, usize ticks)
+{
+    sdl_mute(true);
+    phase_reset();
+    usize entities = 0;
+    f64 start = timer_now();
+    for (usize i = 0; i < ticks; i++) {
+        script_input(&state->input, state->tick);
+        update(state, BENCH_DT);
+        entities += state->asteroids.length + state->bullets.length +
+                    state->particles.length;
+    }
+    f64 secs = timer_now() - start;
+    printf("scalar: %s\n", SCALAR_NAME);
+    printf("ticks: %lu in %.3f s, %.2f us/tick, %.0f ticks/s\n",
+            ticks, secs, 1e6 * secs / ticks, ticks / secs);
+    printf("mean entities: %.1f, final score: %lu, state hash: %016lx\n",
+            (f64) entities / ticks, state->score, state_hash(state));
+    print_sat_stats();
+    print_physics_stats(state);
+    print_phase_stats();
+    sdl_mute(false);
 }
 
-void render(const GameState *state)
+/*
+ * player_lead is extra rotation for the player that is drawn but not
+ * simulated, used to show late-latched steering.
+ */
+void render(const GameState *state, f64 player_lead)
 {
+    phase_start();
     sdl_clear();
 
     // Render score
     if (state->input.status == PLAYING || state->input.status == OVER) {
         sdl_render_score(state->score);
     }
+    phase_end(PHASE_CLEAR);
 
-    // Render particles
-    for (usize i = 0; i < state->particles.length; i++) {
+    // Render particles, only the newest ones at lower quality
+    usize drawn = QUALITY_LEVELS[state->input.quality].drawn_particles;
+    usize first = state->particles.length > drawn ? state->particles.length - drawn : 0;
+    for (usize i = first; i < state->particles.length; i++) {
         const Entity *particle = &state->entities[state->particles.idxs[i]];
-        sdl_draw_polygon(&particle->poly, particle->color);
+        Polygon poly = entity_poly(state, particle);
+        sdl_draw_polygon(&poly, particle->color);
     }
+    phase_end(PHASE_DRAW_PARTICLES);
 
     // Render asteroids
     for (usize i = 0; i < state->asteroids.length; i++) {
         const Entity *asteroid = &state->entities[state->asteroids.idxs[i]];
-        sdl_draw_polygon(&asteroid->poly, asteroid->color);
+        Polygon poly = entity_poly(state, asteroid);
+        if (!sdl_draw_sprite(
+                asteroid->shape,
+                &poly,
+                asteroid->cent,
+                asteroid->theta,
+                asteroid->color)) {
+            sdl_draw_polygon(&poly, asteroid->color);
+        }
     }
+    phase_end(PHASE_DRAW_ASTEROIDS);
 
     // Render bullets
     for (usize i = 0; i < state->bullets.length; i++) {
         const Entity *bullet = &state->entities[state->bullets.idxs[i]];
-        sdl_draw_polygon(&bullet->poly, bullet->color);
+        Polygon poly = entity_poly(state, bullet);
+        sdl_draw_polygon(&poly, bullet->color);
     }
+    phase_end(PHASE_DRAW_BULLETS);
 
     // Render player
     if (state->input.status == PLAYING) {
         const Entity *player = &state->entities[state->player];
-        sdl_draw_polygon(&player->poly, player->color);
+        Polygon poly = entity_poly(state, player);
+        Vector2 points[MAX_POINTS];
+        if (player_lead != 0.0) {
+            for (usize i = 0; i < poly.n; i++) {
+                points[i] = poly.points[i];
+            }
+            poly.points = points;
+            poly_rotate(&poly, player_lead, player->cent);
+        }
+        sdl_draw_polygon(&poly, player->color);
+    }
+    phase_end(PHASE_DRAW_PLAYER);
+
+    // Capture frame, waiting for the writer only when nothing is on screen
+    if (capture_active()) {
+        u8 *frame = capture_acquire(sdl_is_headless());
+        if (frame) {
+            sdl_read_frame(frame);
+            capture_submit(frame);
+        }
     }
 
     sdl_show();
+    phase_end(PHASE_PRESENT);
+}
+
+void export_entities(
+    ExportFrame *frame,
+    const GameState *state,
+    const EntityIndexArray *arr,
+    ExportKind kind)
+{
+    for (usize i = 0; i < arr->length; i++) {
+        const Entity *entity = &state->entities[arr->idxs[i]];
+        frame->entities[frame->count] = (ExportEntity) {
+            .id = arr->idxs[i],
+            .kind = kind,
+            .x = scalar_to_f64(entity->cent.x),
+            .y = scalar_to_f64(entity->cent.y),
+            .theta = entity->theta,
+            .vx = scalar_to_f64(entity->v.x),
+            .vy = scalar_to_f64(entity->v.y),
+        };
+        frame->count += 1;
+    }
+}
+
+void fill_export_frame(ExportFrame *frame, const GameState *state)
+{
+    frame->tick = state->tick;
+    frame->score = state->score;
+    frame->status = state->input.status;
+    frame->quality = state->input.quality;
+    frame->count = 0;
+    if (state->input.status == PLAYING) {
+        EntityIndexArray player = { .idxs = { state->player }, .length = 1 };
+        export_entities(frame, state, &player, EXPORT_PLAYER);
+    }
+    export_entities(frame, state, &state->asteroids, EXPORT_ASTEROID);
+    export_entities(frame, state, &state->bullets, EXPORT_BULLET);
+    export_entities(frame, state, &state->particles, EXPORT_PARTICLE);
 }
 
-void on_key(u8 key, KeyEventType type, f64 held_time, InputState *input)
+void export_state(const GameState *state)
 {
+    fill_export_frame(export_begin(), state);
+    export_end();
+}
+
+void stream_state(const GameState *state)
+{
+    ExportFrame *frame = stream_acquire();
+    if (frame) {
+        fill_export_frame(frame, state);
+        stream_submit(frame);
+    }
+}
+
+void on_key(u8 key, KeyEventType type, f64 held_time, f64 timestamp, InputState *input)
+{
+    // Key repeats change nothing, so they are not worth timing
+    if ((held_time == 0.0 || type == KEY_RELEASED) && input->input_time == 0.0) {
+        input->input_time = timestamp;
+    }
+
     switch(input->status) {
         case START:
         {
@@ -627,23 +1639,783 @@ void on_key(u8 key, KeyEventType type, f64 held_time, InputState *input)
     }
 }
 
-int main(void)
+/*
+ * What a replay (replay.h) holds of each tick: the input as update() saw
+ * it, status and timestamps included so that resimulated states hash the
+ * same, and the asteroids a scenario spawned before it. Keyframes are
+ * taken after those, right before update().
+ */
+typedef struct {
+    InputState input;
+    f64 dt;
+    u64 spawns;
+} ReplayTick;
+
+#ifdef FAST_TRIG
+#define REPLAY_TRIG " fast_trig"
+#else
+#define REPLAY_TRIG ""
+#endif
+#define REPLAY_TAG CAPACITY_PROFILE " " SCALAR_NAME REPLAY_TRIG
+
+/* REPLAY=path records the session, REPLAY_KEYFRAME sets the interval */
+void replay_setup(void)
+{
+    const char *path = getenv("REPLAY");
+    const char *interval = getenv("REPLAY_KEYFRAME");
+    if (path && !replay_open(path, sizeof(GameState), sizeof(ReplayTick),
+                interval ? strtoul(interval, NULL, 10) : REPLAY_KEYFRAME_TICKS,
+                narrow_phase, REPLAY_TAG)) {
+        fprintf(stderr, "Unable to record a replay to %s\n", path);
+    }
+}
+
+void replay_finish(void)
+{
+    if (replay_active()) {
+        ReplayStats stats = replay_close();
+        printf("replay: %lu ticks, %lu keyframes, %lu bytes%s\n", stats.ticks,
+                stats.keyframes, stats.bytes, stats.failed ? ", WRITE FAILED" : "");
+    }
+}
+
+/* Record the tick state is about to run, once everything but update() is done */
+void replay_tick(const GameState *state, f64 dt, usize spawns)
+{
+    if (replay_active()) {
+        ReplayTick in;
+        memset(&in, 0, sizeof(in));
+        memcpy(&in.input, &state->input, sizeof(InputState));
+        in.dt = dt;
+        in.spawns = spawns;
+        replay_record(state->tick, state, &in);
+    }
+}
+
+/*
+ * Redo what happened to the state of tick t before update(), unless it
+ * was loaded from tick t's keyframe, which has it already. Returns the dt.
+ */
+f64 replay_apply(GameState *state, const Replay *replay, u64 t, bool loaded)
+{
+    ReplayTick in;
+    memcpy(&in, replay_input(replay, t), sizeof(in));
+    if (!loaded) {
+        for (u64 i = 0; i < in.spawns; i++) {
+            spawn_asteroid(state);
+        }
+        memcpy(&state->input, &in.input, sizeof(InputState));
+    }
+    return in.dt;
+}
+
+void print_entities(const ExportFrame *frame)
+{
+    const char *kinds[] = { "player", "asteroid", "bullet", "particle" };
+    for (usize i = 0; i < frame->count; i++) {
+        const ExportEntity *e = &frame->entities[i];
+        printf("  %3u %-8s pos (%8.2f, %8.2f) theta %6.2f vel (%8.2f, %8.2f)\n",
+                e->id, kinds[e->kind % 4], e->x, e->y, e->theta, e->vx, e->vy);
+    }
+}
+
+/*
+ * Seek a replay to tick from, by loading the keyframe before it and
+ * resimulating the rest, then run it through tick to printing each tick's
+ * state hash, counts and the time of each phase of its update(), and with
+ * verbose every entity. Every keyframe the run reaches must match the
+ * resimulated state.
+ */
+bool replay_dump(GameState *state, const char *path, u64 from, u64 to, bool verbose,
+        bool rendering)
+{
+    Replay replay;
+    if (!replay_load(path, &replay, sizeof(GameState), sizeof(ReplayTick), REPLAY_TAG)) {
+        return false;
+    }
+    sdl_mute(true);
+    narrow_phase = replay.header->rules == NARROW_GJK ? NARROW_GJK : NARROW_SAT;
+    u64 first = replay.header->first_tick;
+    u64 end = replay_end(&replay);
+    printf("replay %s: ticks %lu to %lu, %lu keyframes every %u ticks%s\n",
+            path, first, end, replay.keyframes, replay.header->interval,
+            replay.recovered ? ", not closed, index rebuilt" : "");
+    if (from < first) from = first;
+    if (to >= end) to = end - 1;
+    if (from > to) {
+        printf("no recorded ticks in the range\n");
+        replay_unload(&replay);
+        sdl_mute(false);
+        return true;
+    }
+
+    f64 start = timer_now();
+    const ReplayKeyframe *key = replay_keyframe(&replay, from);
+    memcpy(state, replay_state(&replay, key), sizeof(GameState));
+    for (u64 t = key->tick; t < from; t++) {
+        update(state, replay_apply(state, &replay, t, t == key->tick));
+    }
+    printf("seek to %lu: keyframe %lu, %lu ticks resimulated in %.3f ms\n",
+            from, key->tick, from - key->tick, 1000.0 * (timer_now() - start));
+
+    printf("tick\thash\t\t\tscore\tasteroids\tbullets\tparticles\tupdate us");
+    for (usize p = 0; p < NUM_UPDATE_PHASES; p++) {
+        printf("\t%s us", PHASE_NAMES[p]);
+    }
+    printf("\n");
+    bool timing = phase_timing;
+    phase_timing = true;
+    phase_reset();
+    usize diverged = 0;
+    usize checked = 0;
+    f64 total = 0.0;
+    static ExportFrame frame;
+    for (u64 t = from; t <= to; t++) {
+        f64 dt = replay_apply(state, &replay, t, t == key->tick);
+        const ReplayKeyframe *at = replay_keyframe(&replay, t);
+        if (at->tick == t && t != key->tick) {
+            checked += 1;
+            if (memcmp(state, replay_state(&replay, at), sizeof(GameState))) {
+                printf("tick %lu DIVERGED from its keyframe, continuing from the keyframe\n", t);
+                memcpy(state, replay_state(&replay, at), sizeof(GameState));
+                diverged += 1;
+            }
+        }
+        printf("%lu\t%016lx\t%lu\t%lu\t\t%lu\t%lu\t\t", t, state_hash(state), state->score,
+                state->asteroids.length, state->bullets.length, state->particles.length);
+        if (verbose) {
+            fill_export_frame(&frame, state);
+        }
+        f64 update_start = timer_now();
+        update(state, dt);
+        f64 update_time = timer_now() - update_start;
+        total += update_time;
+        printf("%.1f", 1e6 * update_time);
+        for (usize p = 0; p < NUM_UPDATE_PHASES; p++) {
+            printf("\t%.1f", 1e6 * phase_times[p]);
+        }
+        printf("\n");
+        if (verbose) {
+            print_entities(&frame);
+        }
+        // Draw the tick too, so CAPTURE records the replay
+        if (rendering) {
+            render(state, 0.0);
+        }
+    }
+    phase_timing = timing;
+    printf("replayed %lu ticks, %.2f us/update, %lu of %lu keyframes matched, "
+            "state hash %016lx at %lu\n", to - from + 1, 1e6 * total / (to - from + 1),
+            checked - diverged, checked, state_hash(state), state->tick);
+    if (counters_active()) {
+        print_phase_stats();
+    }
+    replay_unload(&replay);
+    sdl_mute(false);
+    return diverged == 0;
+}
+
+/*
+ * Every allocated entity slot must be referenced by exactly one of the
+ * player and the index arrays, and the vertex arena must account for
+ * exactly the vertices those entities hold.
+ */
+bool check_pools(const GameState *state)
+{
+    u8 refs[MAX_ENTITIES] = {0};
+    const EntityIndexArray *arrays[] = {
+        &state->asteroids, &state->bullets, &state->particles,
+    };
+    refs[state->player] += 1;
+    for (usize a = 0; a < sizeof(arrays) / sizeof(arrays[0]); a++) {
+        for (usize i = 0; i < arrays[a]->length; i++) {
+            refs[arrays[a]->idxs[i]] += 1;
+        }
+    }
+    usize vertices = 0;
+    for (usize i = 0; i < MAX_ENTITIES; i++) {
+        if (refs[i] != !state->free[i]) {
+            fprintf(stderr, "entity %lu: %s with %u references\n",
+                    i, state->free[i] ? "free" : "allocated", refs[i]);
+            return false;
+        }
+        if (!state->free[i]) {
+            vertices += state->entities[i].verts.n;
+        }
+    }
+    if (vertices != state->arena.used || !arena_check(&state->arena)) {
+        fprintf(stderr, "vertex arena: %lu used, %lu held by entities\n",
+                state->arena.used, vertices);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Spawn the scenario's waves for tick t and choose the tick's input.
+ * Returns the asteroids spawned.
+ */
+usize scenario_input(GameState *state, const Scenario *scenario, u64 t)
+{
+    usize spawns = scenario_spawns(scenario, t);
+    for (usize i = spawns; i > 0; i--) {
+        spawn_asteroid(state);
+    }
+    if (scenario->restart_every && t % scenario->restart_every == 0) {
+        state->input.restarting = true;
+    } else {
+        autopilot(state, &state->input);
+    }
+    return spawns;
+}
+
+/*
+ * Run a scenario under the autopilot, rendering every tick, and report
+ * throughput, frame times and entity counts per window of SOAK_WINDOW
+ * ticks. Pools are checked after every tick, which covers restarts.
+ * Given a governor, it sets the quality from each tick's cost.
+ */
+bool soak(GameState *state, const Scenario *scenario, QualityGovernor *governor)
+{
+    sdl_mute(true);
+    state->init_asteroids = scenario->asteroids;
+    state->max_asteroids = scenario->max_asteroids;
+    init_game(state);
+    phase_reset();
+
+    bool ok = check_pools(state);
+    usize restarts = 0;
+    f64 worst = 0.0;
+    f64 window_worst = 0.0;
+    f64 window_start = timer_now();
+    f64 start = window_start;
+    usize peak_entities = 0;
+    printf("tick\tticks/s\tmean ms\tworst ms\tasteroids\tbullets\tparticles\tpeak\tquality\n");
+    for (u64 t = 1; ok && t <= scenario->duration; t++) {
+        usize spawns = scenario_input(state, scenario, t);
+        restarts += state->input.restarting;
+        replay_tick(state, BENCH_DT, spawns);
+
+        f64 frame_start = timer_now();
+        update(state, BENCH_DT);
+        render(state, 0.0);
+        f64 frame = timer_now() - frame_start;
+        if (frame > window_worst) window_worst = frame;
+        if (governor) {
+            state->input.quality = quality_governor_update(governor, frame);
+        }
+        ok = check_pools(state);
+
+        usize entities = state->asteroids.length + state->bullets.length +
+                         state->particles.length;
+        if (entities > peak_entities) peak_entities = entities;
+        if (t % SOAK_WINDOW == 0 || t == scenario->duration) {
+            usize ticks = t % SOAK_WINDOW ? t % SOAK_WINDOW : SOAK_WINDOW;
+            f64 now = timer_now();
+            printf("%lu\t%.0f\t%.3f\t%.3f\t%lu\t%lu\t%lu\t%lu\t%u\n",
+                    t, ticks / (now - window_start),
+                    1000.0 * (now - window_start) / ticks, 1000.0 * window_worst,
+                    state->asteroids.length, state->bullets.length,
+                    state->particles.length, peak_entities,
+                    state->input.quality);
+            if (window_worst > worst) worst = window_worst;
+            window_worst = 0.0;
+            peak_entities = 0;
+            window_start = now;
+        }
+    }
+    f64 secs = timer_now() - start;
+    printf("soak: %lu ticks in %.3f s, worst frame %.3f ms, %lu restarts, "
+            "pools %s, state hash %016lx\n",
+            state->tick, secs, 1000.0 * worst, restarts,
+            ok ? "ok" : "LEAKED", state_hash(state));
+    print_phase_stats();
+    sdl_mute(false);
+    return ok;
+}
+
+/*
+ * Stream a scenario's ticks through the delta encoder and the reference
+ * decoder, checking every decoded frame against the quantized original,
+ * and report bandwidth and the CPU cost per tick of each step.
+ */
+bool stream_bench(GameState *state, const Scenario *scenario)
+{
+    static ExportFrame frame;
+    static ExportFrame decoded;
+    static ExportEntity by_id[MAX_ENTITIES];
+    static StreamEncoder encoder;
+    static StreamDecoder decoder;
+    static u8 buffer[STREAM_HEADER_BYTES + STREAM_MAX_FRAME_BYTES];
+
+    sdl_mute(true);
+    state->init_asteroids = scenario->asteroids;
+    state->max_asteroids = scenario->max_asteroids;
+    init_game(state);
+    stream_encoder_init(&encoder);
+    stream_decoder_init(&decoder);
+
+    f64 fill_time = 0.0;
+    f64 encode_time = 0.0;
+    f64 decode_time = 0.0;
+    u64 bytes = 0;
+    u64 raw_bytes = 0;
+    usize largest = 0;
+    usize mismatches = 0;
+    for (u64 t = 1; t <= scenario->duration; t++) {
+        scenario_input(state, scenario, t);
+        update(state, BENCH_DT);
+
+        // The first frame carries the stream header in front of it
+        usize offset = t == 1 ? stream_write_header(buffer) : 0;
+        f64 start = timer_now();
+        fill_export_frame(&frame, state);
+        f64 filled = timer_now();
+        usize length = offset + stream_encode(&encoder, &frame, buffer + offset);
+        f64 encoded = timer_now();
+        usize consumed = 0;
+        StreamResult result = stream_decode(&decoder, buffer, length, &consumed, &decoded);
+        f64 end = timer_now();
+        fill_time += filled - start;
+        encode_time += encoded - filled;
+        decode_time += end - encoded;
+        bytes += length;
+        raw_bytes += sizeof(ExportFrame) - sizeof(frame.entities) +
+                     frame.count * sizeof(ExportEntity);
+        if (length > largest) largest = length;
+
+        stream_quantize(&frame);
+        bool same = result == STREAM_FRAME && consumed == length &&
+            decoded.tick == frame.tick && decoded.score == frame.score &&
+            decoded.status == frame.status && decoded.quality == frame.quality &&
+            decoded.count == frame.count;
+        for (usize i = 0; same && i < decoded.count; i++) {
+            by_id[decoded.entities[i].id] = decoded.entities[i];
+        }
+        for (usize i = 0; same && i < frame.count; i++) {
+            same = !memcmp(&by_id[frame.entities[i].id], &frame.entities[i],
+                           sizeof(ExportEntity));
+        }
+        mismatches += !same;
+    }
+
+    u64 ticks = scenario->duration;
+    printf("frames: %lu, %.1f bytes/tick (largest %lu), %.1f kbit/s at 60 Hz\n",
+            ticks, (f64) bytes / ticks, largest, 60.0 * 8.0 * bytes / ticks / 1000.0);
+    printf("uncompressed ExportFrames: %.1f bytes/tick, %.1fx larger\n",
+            (f64) raw_bytes / ticks, (f64) raw_bytes / bytes);
+    printf("per tick: fill %.2f us, encode %.2f us, decode %.2f us\n",
+            1e6 * fill_time / ticks, 1e6 * encode_time / ticks, 1e6 * decode_time / ticks);
+    printf("decoded frames differing from the quantized state: %lu\n", mismatches);
+    sdl_mute(false);
+    return mismatches == 0;
+}
+
+/*
+ * Run a scenario without rendering on 1 to max_threads job threads, each
+ * time from the same fresh state, for the scaling curve of update(). The
+ * final state must hash the same on every thread count.
+ */
+bool jobs_bench(GameState *state, const Scenario *scenario, usize max_threads)
+{
+    sdl_mute(true);
+    printf("scalar: %s, entities: %d\n", SCALAR_NAME, MAX_ENTITIES);
+    printf("threads\tticks/s\tus/tick\tspeedup\tsteals/tick\tstate hash\n");
+    bool ok = true;
+    f64 serial = 0.0;
+    u64 expected = 0;
+    for (usize threads = 1; threads <= max_threads; threads++) {
+        jobs_quit();
+        jobs_init(threads);
+        for (usize i = 0; i < state->asteroids.length; i++) {
+            sdl_release_sprite(state->entities[state->asteroids.idxs[i]].shape);
+        }
+        bool contacts = state->asteroid_contacts;
+        memset(state, 0, sizeof(GameState));
+        state->asteroid_contacts = contacts;
+        state->rng = RNG_SEED;
+        state->init_asteroids = scenario->asteroids;
+        state->max_asteroids = scenario->max_asteroids;
+        init_game(state);
+
+        f64 start = timer_now();
+        for (u64 t = 1; t <= scenario->duration; t++) {
+            scenario_input(state, scenario, t);
+            update(state, BENCH_DT);
+        }
+        f64 secs = timer_now() - start;
+        u64 hash = state_hash(state);
+        if (threads == 1) {
+            serial = secs;
+            expected = hash;
+        }
+        ok = ok && hash == expected;
+        printf("%lu\t%.0f\t%.2f\t%.2f\t%.2f\t%016lx%s\n",
+                jobs_threads(), scenario->duration / secs,
+                1e6 * secs / scenario->duration, serial / secs,
+                (f64) jobs_stats().steals / scenario->duration,
+                hash, hash == expected ? "" : " MISMATCH");
+    }
+    print_physics_stats(state);
+    sdl_mute(false);
+    return ok;
+}
+
+/*
+ * Bytes and high water of every static pool, by subsystem, against the
+ * profile's budgets. The export segment is shared memory, mapped only
+ * while exporting.
+ */
+void print_memory_pools(bool exporting)
+{
+    printf("profile %s: MAX_ENTITIES %d, ARENA_VERTICES %d, ROLLBACK_TICKS %d\n",
+            CAPACITY_PROFILE, MAX_ENTITIES, ARENA_VERTICES, ROLLBACK_TICKS);
+    const MemoryPool *pools;
+    MemoryPool group[8];
+    usize n = 0;
+    usize total = 0;
+    total += memory_print("state", state_pools, NUM_STATE_POOLS, MEMORY_BUDGET_STATE);
+    total += memory_print("rollback", &rollback_pool, 1, MEMORY_BUDGET_ROLLBACK);
+
+    n = jobs_memory(&pools);
+    memcpy(group, pools, n * sizeof(MemoryPool));
+    group[n++] = hit_pool;
+    group[n] = sat_cache_pool;
+    for (usize t = 0; t < JOBS_MAX_THREADS; t++) {
+        group[n].high_water += sat_filled[t];
+    }
+    n++;
+    total += memory_print("jobs", group, n, MEMORY_BUDGET_JOBS);
+
+    n = physics_memory(&pools);
+    memcpy(group, pools, n * sizeof(MemoryPool));
+    group[n++] = body_pool;
+    total += memory_print("physics", group, n, MEMORY_BUDGET_PHYSICS);
+
+    n = sdl_memory(&pools);
+    total += memory_print("render", pools, n, MEMORY_BUDGET_RENDER);
+
+    n = capture_memory(&pools);
+    memcpy(group, pools, n * sizeof(MemoryPool));
+    usize m = stream_memory(&pools);
+    memcpy(&group[n], pools, m * sizeof(MemoryPool));
+    n += m;
+    group[n++] = (MemoryPool) { "export segment", sizeof(ExportSegment), 1, exporting };
+    replay_memory(&pools);
+    group[n++] = *pools;
+    total += memory_print("io", group, n, MEMORY_BUDGET_IO);
+
+    printf("total    %10lu bytes, %5.1f%% of %d budget%s\n", total,
+            100.0 * total / MEMORY_BUDGET_TOTAL, MEMORY_BUDGET_TOTAL,
+            total > MEMORY_BUDGET_TOTAL ? ", OVER BUDGET" : "");
+}
+
+/*
+ * Compare the vertex arena with embedded vertices, then run a scripted
+ * session (drawn, when headless) for the pools' high water.
+ */
+void memory_report(GameState *state, usize ticks, bool exporting)
+{
+    sdl_mute(true);
+    usize peak_used = 0;
+    usize peak_holes = 0;
+    usize sum_used = 0;
+    for (usize i = 0; i < ticks; i++) {
+        script_input(&state->input, state->tick);
+        update(state, BENCH_DT);
+        if (sdl_is_headless()) {
+            render(state, 0.0);
+        }
+        usize used = state->arena.used;
+        sum_used += used;
+        if (used > peak_used) peak_used = used;
+        if (state->arena.free_length > peak_holes) {
+            peak_holes = state->arena.free_length;
+        }
+    }
+    track_state_memory(state);
+    usize fixed_poly = MAX_POINTS * sizeof(Vector2) + sizeof(usize);
+    usize fixed_entity = sizeof(Entity) - sizeof(VertexRange) + fixed_poly;
+    printf("entity: %lu bytes (%lu with embedded vertices)\n",
+            sizeof(Entity), fixed_entity);
+    printf("shape storage: %lu bytes arena for %d vertices "
+            "(%lu bytes embedded for %d)\n",
+            sizeof(VertexArena), ARENA_VERTICES,
+            MAX_ENTITIES * fixed_poly, MAX_ENTITIES * MAX_POINTS);
+    printf("game state: %lu bytes (%lu with embedded vertices)\n",
+            sizeof(GameState), sizeof(GameState) - sizeof(VertexArena) +
+            MAX_ENTITIES * (fixed_entity - sizeof(Entity)));
+    if (ticks > 0) {
+        printf("over %lu ticks: mean %.1f, peak %lu, high water %lu of %d vertices, "
+                "peak %lu holes\n",
+                ticks, (f64) sum_used / ticks, peak_used, state->arena.high_water,
+                ARENA_VERTICES, peak_holes);
+    }
+    print_memory_pools(exporting);
+    sdl_mute(false);
+}
+
+/*
+ * QUALITY=auto governs the quality level against QUALITY_BUDGET_MS per
+ * frame (default FRAME_BUDGET), QUALITY=<level> pins it. Returns whether
+ * the governor is in charge.
+ */
+bool quality_setup(GameState *state, QualityGovernor *governor)
+{
+    const char *mode = getenv("QUALITY");
+    const char *budget_ms = getenv("QUALITY_BUDGET_MS");
+    quality_governor_init(governor,
+            budget_ms ? atof(budget_ms) / 1000.0 : FRAME_BUDGET, NUM_QUALITY_LEVELS - 1);
+    if (!mode) {
+        return false;
+    }
+    if (!strcmp(mode, "auto")) {
+        return true;
+    }
+    usize level = strtoull(mode, NULL, 10);
+    state->input.quality = level < NUM_QUALITY_LEVELS ? level : NUM_QUALITY_LEVELS - 1;
+    return false;
+}
+
+/* Flush and close whatever outputs main() opened, on every way out */
+void quit_game(bool exporting)
+{
+    if (capture_active()) {
+        CaptureStats stats = capture_stop();
+        printf("captured %lu frames, dropped %lu%s\n", stats.written, stats.dropped,
+                stats.failed ? ", WRITE FAILED" : "");
+    }
+    replay_finish();
+    if (exporting) {
+        export_close();
+    }
+    if (stream_active()) {
+        StreamStats stats = stream_close();
+        printf("streamed %lu frames (%lu bytes), dropped %lu\n",
+                stats.frames, stats.bytes, stats.dropped);
+    }
+    counters_close();
+    jobs_quit();
+    sdl_quit();
+}
+
+int main(int argc, char **argv)
 {
     sdl_init();
     sdl_on_key((KeyHandler) on_key);
+    const char *capture_path = getenv("CAPTURE");
+    if (capture_path && !capture_start(capture_path, CAPTURE_FPS)) {
+        fprintf(stderr, "Unable to capture to %s\n", capture_path);
+    }
+    const char *export_name = getenv("STATE_EXPORT");
+    bool exporting = false;
+    if (export_name) {
+        if (!strcmp(export_name, "1")) {
+            export_name = STATE_EXPORT_NAME;
+        }
+        exporting = export_open(export_name);
+        if (!exporting) {
+            fprintf(stderr, "Unable to export state to %s\n", export_name);
+        }
+    }
+    const char *stream_target = getenv("STATE_STREAM");
+    if (stream_target && !stream_open(stream_target)) {
+        fprintf(stderr, "Unable to stream state to %s\n", stream_target);
+    }
+    const char *sat_cache_mode = getenv("SAT_CACHE");
+    sat_caching = sat_cache_mode && !strcmp(sat_cache_mode, "1");
+    const char *narrow = getenv("NARROW_PHASE");
+    if (narrow && !strcmp(narrow, "gjk")) {
+        narrow_phase = NARROW_GJK;
+    } else if (narrow && strcmp(narrow, "sat")) {
+        fprintf(stderr, "Unknown NARROW_PHASE %s, using sat\n", narrow);
+    }
+    // PERF_COUNTERS=1 times the phases of update() and render() and reads
+    // the hardware counters around them, for the benchmarks to print
+    const char *perf_counters = getenv("PERF_COUNTERS");
+    if (perf_counters && !strcmp(perf_counters, "1")) {
+        phase_timing = true;
+        counters_open();
+    }
+    const char *job_threads = getenv("JOBS_THREADS");
+    jobs_init(job_threads ? strtoull(job_threads, NULL, 10) : 1);
     static GameState state;
+    const char *contacts = getenv("ASTEROID_CONTACTS");
+    state.asteroid_contacts = !contacts || strcmp(contacts, "0");
+    state.rng = RNG_SEED;
+    state.init_asteroids = INIT_NUM_ASTEROIDS;
+    state.max_asteroids = MAX_NUM_ASTEROIDS;
     init_game(&state);
+    QualityGovernor governor;
+    bool governing = quality_setup(&state, &governor);
+
+    if (argc > 1 && !strcmp(argv[1], "--rollback-bench")) {
+        usize rounds = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000;
+        bool ok = rollback_bench(&state, 10 * ROLLBACK_TICKS, rounds);
+        quit_game(exporting);
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--tick-bench")) {
+        usize ticks = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+        tick_bench(&state, ticks);
+        quit_game(exporting);
+        return 0;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--soak")) {
+        Scenario scenario = {
+            .duration = 36000,
+            .asteroids = INIT_NUM_ASTEROIDS,
+            .max_asteroids = MAX_NUM_ASTEROIDS,
+        };
+        if (argc > 2 && !scenario_load(argv[2], &scenario)) {
+            fprintf(stderr, "Unable to load scenario %s\n", argv[2]);
+            quit_game(exporting);
+            return 1;
+        }
+        replay_setup();
+        bool ok = soak(&state, &scenario, governing ? &governor : NULL);
+        if (getenv("MEMORY_REPORT")) {
+            track_state_memory(&state);
+            print_memory_pools(exporting);
+        }
+        quit_game(exporting);
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--stream-bench")) {
+        Scenario scenario = {
+            .duration = 36000,
+            .asteroids = INIT_NUM_ASTEROIDS,
+            .max_asteroids = MAX_NUM_ASTEROIDS,
+        };
+        if (argc > 2 && !scenario_load(argv[2], &scenario)) {
+            fprintf(stderr, "Unable to load scenario %s\n", argv[2]);
+            quit_game(exporting);
+            return 1;
+        }
+        bool ok = stream_bench(&state, &scenario);
+        quit_game(exporting);
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--jobs-bench")) {
+        Scenario scenario = {
+            .duration = 3600,
+            .asteroids = INIT_NUM_ASTEROIDS,
+            .max_asteroids = MAX_NUM_ASTEROIDS,
+        };
+        if (argc > 2 && !scenario_load(argv[2], &scenario)) {
+            fprintf(stderr, "Unable to load scenario %s\n", argv[2]);
+            quit_game(exporting);
+            return 1;
+        }
+        usize max_threads = argc > 3 ? strtoull(argv[3], NULL, 10) : 8;
+        bool ok = jobs_bench(&state, &scenario, max_threads);
+        quit_game(exporting);
+        return ok ? 0 : 1;
+    }
+    if (argc > 2 && !strcmp(argv[1], "--replay")) {
+        u64 from = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+        u64 to = argc > 4 ? strtoull(argv[4], NULL, 10) : UINT64_MAX;
+        bool verbose = false;
+        bool rendering = false;
+        for (int i = 5; i < argc; i++) {
+            verbose |= !strcmp(argv[i], "-v");
+            rendering |= !strcmp(argv[i], "-r");
+        }
+        bool ok = replay_dump(&state, argv[2], from, to, verbose, rendering);
+        quit_game(exporting);
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--memory-report")) {
+        usize ticks = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+        memory_report(&state, ticks, exporting);
+        quit_game(exporting);
+        return 0;
+    }
+    // RENDER_SCALE is a fixed fraction of the window, or "auto" to hold
+    // RENDER_BUDGET_MS per frame
+    const char *scale_mode = getenv("RENDER_SCALE");
+    const char *budget_ms = getenv("RENDER_BUDGET_MS");
+    bool auto_scale = scale_mode && !strcmp(scale_mode, "auto");
+    bool debug_overlay = getenv("DEBUG_OVERLAY") != NULL;
+    ScaleController scaler;
+    scale_controller_init(&scaler,
+            budget_ms ? atof(budget_ms) / 1000.0 : FRAME_BUDGET, MIN_RENDER_SCALE);
+    if (scale_mode && !auto_scale) {
+        sdl_set_render_scale(atof(scale_mode));
+    }
+
+    // LATE_LATCH polls input again after the update and draws the player
+    // turned by the latest steering, without changing the simulation
+    bool late_latch = getenv("LATE_LATCH") != NULL;
+    bool running = true;
+    Histogram latency;
+    histogram_init(&latency, LATENCY_BUCKET);
+
     f64 t = 0.0;
     usize frames = 0;
+    replay_setup();
 
-    while (sdl_running(&state.input)) {
+    while (running && sdl_running(&state.input)) {
         f64 dt = time_since_last_tick();
         t += dt;
         frames++;
+        replay_tick(&state, dt, 0);
+        f64 update_start = timer_now();
         update(&state, dt);
-        render(&state);
+        f64 update_time = timer_now() - update_start;
+        if (exporting) {
+            export_state(&state);
+        }
+        if (stream_active()) {
+            stream_state(&state);
+        }
+
+        f64 cpu, gpu;
+        sdl_frame_times(&cpu, &gpu);
+        if (auto_scale) {
+            sdl_set_render_scale(scale_controller_update(&scaler, cpu + gpu));
+        }
+        if (governing) {
+            state.input.quality = quality_governor_update(&governor, update_time + cpu + gpu);
+        }
+        if (debug_overlay) {
+            char text[128];
+            snprintf(text, sizeof(text), "scale %.2f  cpu %.2f ms  gpu %.2f ms  quality %u",
+                    sdl_render_scale(), 1000.0 * cpu, 1000.0 * gpu, state.input.quality);
+            sdl_set_debug_text(text);
+        }
+
+        // Everything polled so far is in this frame
+        f64 input_time = state.input.input_time;
+        state.input.input_time = 0.0;
+        f64 player_lead = 0.0;
+        if (late_latch) {
+            f64 omega = steering_omega(&state.input);
+            running = sdl_running(&state.input);
+            f64 latched = steering_omega(&state.input);
+            player_lead = dt * latched;
+            // Only steering shows early, other late input waits a frame
+            if (latched != omega) {
+                if (input_time == 0.0) {
+                    input_time = state.input.input_time;
+                }
+                state.input.input_time = 0.0;
+            }
+        }
+        render(&state, player_lead);
+        if (input_time > 0.0) {
+            histogram_add(&latency, timer_now() - input_time);
+        }
     }
     printf("%f fps\n", (f64) frames / t);
+    print_phase_stats();
+    if (latency.count > 0) {
+        histogram_print(&latency, "input to present", 1000.0, "ms");
+    }
+    if (getenv("MEMORY_REPORT")) {
+        track_state_memory(&state);
+        print_memory_pools(exporting);
+    }
 
-    sdl_quit();
+    quit_game(exporting);
 }
@@ -0,0 +1,43 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include "base.h"
+#include "const.h"
+#include "memory_budget.h"
+
+/*
+ * Frame capture to disk. Rendered frames are read back into one of a small
+ * pool of reusable RGBA buffers and handed to a background writer thread
+ * through a bounded queue, so the render loop never waits on file I/O.
+ * Paths ending in .rgba get raw RGBA frames; anything else gets a Y4M
+ * (4:4:4) stream playable by ffmpeg/mpv.
+ */
+
+// CAPTURE_POOL, the number of frame buffers, is in the capacity profile
+#define CAPTURE_FRAME_BYTES (WIDTH * HEIGHT * 4)
+
+typedef struct {
+    u64 written;
+    u64 dropped;
+    bool failed; // A write failed and later frames were discarded
+} CaptureStats;
+
+bool capture_start(const char *path, u32 fps);
+
+bool capture_active(void);
+
+/*
+ * Get a free frame buffer. If the writer has fallen behind and every buffer
+ * is queued, either wait for one or return NULL and count a dropped frame.
+ */
+u8 *capture_acquire(bool wait);
+
+void capture_submit(u8 *frame);
+
+/* Flush queued frames, stop the writer and close the file */
+CaptureStats capture_stop(void);
+
+/* The frame buffer pool, returns how many pools */
+usize capture_memory(const MemoryPool **pools);
+
+#endif
@@ -4,6 +4,54 @@
 #include "base.h"
 #include "polygon.h"
 
+/*
+ * Separating axis tests. Axes are numbered by edge, poly1's edges first
+ * and then poly2's, and tested in that order. find_separating_axis()
+ * gives the first one that separates the pair, or SAT_OVERLAP.
+ *
+ * Pairs that are near but apart usually stay apart along the same axis
+ * from one tick to the next, so find_collision_warm() tests the axis in
+ * the hint first and only runs the full test when it no longer separates,
+ * leaving the axis found (or SAT_OVERLAP) in the hint. A separating axis
+ * proves the pair apart whatever the hint came from, so the result is
+ * always exactly find_collision()'s.
+ */
+
+#define SAT_OVERLAP (-1)
+#define SAT_NO_HINT (-2)
+
+/* Narrow phase the game runs, picked with NARROW_PHASE=sat|gjk */
+typedef enum {
+    NARROW_SAT,
+    NARROW_GJK,
+} NarrowPhase;
+
+typedef struct {
+    i32 axis; // Separating axis, SAT_OVERLAP or SAT_NO_HINT
+} SatHint;
+
+typedef struct {
+    u64 tests;
+    u64 warm; // Tests with a separating axis hint
+    u64 hits; // Of those, the hint still separated
+    u64 overlapping; // Tests of pairs that overlapped last time
+    u64 axes; // Axes tested in all
+    u64 saved; // Axes before the hint that a cold test would have tried
+} SatStats;
+
+/* Separating axis test, unrolled for the counts in poly_has_kernel() */
 bool find_collision(Polygon *poly1, Polygon *poly2);
 
+bool find_collision_generic(Polygon *poly1, Polygon *poly2);
+
+i32 find_separating_axis(Polygon *poly1, Polygon *poly2);
+
+bool sat_axis_separates(Polygon *poly1, Polygon *poly2, usize axis);
+
+/* find_collision() or find_collision_gjk() */
+bool narrow_collision(NarrowPhase phase, Polygon *poly1, Polygon *poly2);
+
+/* find_collision() starting from hint, which is updated, counted in stats */
+bool find_collision_warm(Polygon *poly1, Polygon *poly2, SatHint *hint, SatStats *stats);
+
 #endif
@@ -7,6 +7,134 @@
 #define ASTEROID_POINTS 10
 
 #define MAX_POINTS 10
-#define MAX_ENTITIES 100
+
+/*
+ * Capacity profiles. Every static pool is sized here, picked by
+ * -DCAPACITY_EMBEDDED, -DCAPACITY_STRESS or neither (desktop), and any one
+ * of them can still be overridden with its own -D. Each subsystem checks
+ * its storage against its MEMORY_BUDGET_* with _Static_assert, and
+ * game_headless --memory-report prints the bytes and high-water marks.
+ */
+#if defined(CAPACITY_EMBEDDED)
+#define CAPACITY_PROFILE "embedded"
+#define PROFILE_ENTITIES 64
+#define PROFILE_ROLLBACK_TICKS 16
+#define PROFILE_RASTER_PRIMS 512
+#define PROFILE_RASTER_TILE_PRIMS 256
+#define PROFILE_THREADS 2
+#define PROFILE_JOBS_QUEUE 64
+#define PROFILE_CAPTURE_POOL 1
+#define PROFILE_STREAM_POOL 2
+#define PROFILE_SPRITE_ATLAS 1024
+#define PROFILE_SAT_CACHE 256
+#define PROFILE_REPLAY_KEYFRAMES 256
+#define MEMORY_BUDGET_STATE (24 * 1024)
+#define MEMORY_BUDGET_ROLLBACK (512 * 1024)
+#define MEMORY_BUDGET_JOBS (16 * 1024)
+#define MEMORY_BUDGET_PHYSICS (32 * 1024)
+#define MEMORY_BUDGET_RENDER (8 * 1024 * 1024)
+#define MEMORY_BUDGET_IO (8 * 1024 * 1024)
+#define MEMORY_BUDGET_TOTAL (12 * 1024 * 1024)
+#elif defined(CAPACITY_STRESS)
+#define CAPACITY_PROFILE "stress"
+#define PROFILE_ENTITIES 2000
+#define PROFILE_ROLLBACK_TICKS 64
+#define PROFILE_RASTER_PRIMS 8192
+#define PROFILE_RASTER_TILE_PRIMS 2048
+#define PROFILE_THREADS 16
+#define PROFILE_JOBS_QUEUE 256
+#define PROFILE_CAPTURE_POOL 4
+#define PROFILE_STREAM_POOL 8
+#define PROFILE_SPRITE_ATLAS 2048
+#define PROFILE_SAT_CACHE 8192
+#define PROFILE_REPLAY_KEYFRAMES 4096
+#define MEMORY_BUDGET_STATE (640 * 1024)
+#define MEMORY_BUDGET_ROLLBACK (40 * 1024 * 1024)
+#define MEMORY_BUDGET_JOBS (512 * 1024)
+#define MEMORY_BUDGET_PHYSICS (1024 * 1024)
+#define MEMORY_BUDGET_RENDER (24 * 1024 * 1024)
+#define MEMORY_BUDGET_IO (32 * 1024 * 1024)
+#define MEMORY_BUDGET_TOTAL (128 * 1024 * 1024)
+#else
+#define CAPACITY_PROFILE "desktop"
+#define PROFILE_ENTITIES 100
+#define PROFILE_ROLLBACK_TICKS 64
+#define PROFILE_RASTER_PRIMS 4096
+#define PROFILE_RASTER_TILE_PRIMS 1024
+#define PROFILE_THREADS 16
+#define PROFILE_JOBS_QUEUE 256
+#define PROFILE_CAPTURE_POOL 4
+#define PROFILE_STREAM_POOL 8
+#define PROFILE_SPRITE_ATLAS 2048
+#define PROFILE_SAT_CACHE 1024
+#define PROFILE_REPLAY_KEYFRAMES 4096
+#define MEMORY_BUDGET_STATE (32 * 1024)
+#define MEMORY_BUDGET_ROLLBACK (2 * 1024 * 1024)
+#define MEMORY_BUDGET_JOBS (128 * 1024)
+#define MEMORY_BUDGET_PHYSICS (64 * 1024)
+#define MEMORY_BUDGET_RENDER (24 * 1024 * 1024)
+#define MEMORY_BUDGET_IO (32 * 1024 * 1024)
+#define MEMORY_BUDGET_TOTAL (48 * 1024 * 1024)
+#endif
+
+#ifndef MAX_ENTITIES
+#define MAX_ENTITIES PROFILE_ENTITIES
+#endif
+
+// Vertices shared by all entity shapes, see vertex_arena.h
+#ifndef ARENA_VERTICES
+#define ARENA_VERTICES (MAX_ENTITIES * MAX_POINTS)
+#endif
+
+#ifndef ROLLBACK_TICKS
+#define ROLLBACK_TICKS PROFILE_ROLLBACK_TICKS
+#endif
+
+// Polygons binned per frame before a flush, in all and per tile (raster.h)
+#ifndef RASTER_MAX_PRIMS
+#define RASTER_MAX_PRIMS PROFILE_RASTER_PRIMS
+#endif
+#ifndef RASTER_MAX_TILE_PRIMS
+#define RASTER_MAX_TILE_PRIMS PROFILE_RASTER_TILE_PRIMS
+#endif
+
+// Job threads and the chunks each thread's deque holds (jobs.h)
+#ifndef JOBS_MAX_THREADS
+#define JOBS_MAX_THREADS PROFILE_THREADS
+#endif
+#ifndef JOBS_QUEUE
+#define JOBS_QUEUE PROFILE_JOBS_QUEUE
+#endif
+
+// Frame buffers in flight to the capture and stream writers
+#ifndef CAPTURE_POOL
+#define CAPTURE_POOL PROFILE_CAPTURE_POOL
+#endif
+#ifndef STREAM_POOL
+#define STREAM_POOL PROFILE_STREAM_POOL
+#endif
+
+// Asteroid pairs from the broad phase and contacts per step (physics.h)
+#ifndef PHYSICS_MAX_PAIRS
+#define PHYSICS_MAX_PAIRS (2 * MAX_ENTITIES)
+#endif
+#ifndef MAX_CONTACTS
+#define MAX_CONTACTS (2 * MAX_ENTITIES)
+#endif
+
+// Keyframes indexed per replay file (replay.h)
+#ifndef REPLAY_MAX_KEYFRAMES
+#define REPLAY_MAX_KEYFRAMES PROFILE_REPLAY_KEYFRAMES
+#endif
+
+// Separating axis hints for colliding pairs, a power of two (game.c)
+#ifndef SAT_CACHE_SLOTS
+#define SAT_CACHE_SLOTS PROFILE_SAT_CACHE
+#endif
+
+// Side of the SDL backend's sprite atlas texture, in pixels
+#ifndef SPRITE_ATLAS
+#define SPRITE_ATLAS PROFILE_SPRITE_ATLAS
+#endif
 
 #endif
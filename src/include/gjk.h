@@ -0,0 +1,50 @@
+#ifndef _GJK_H_
+#define _GJK_H_
+
+#include "base.h"
+#include "polygon.h"
+
+/*
+ * GJK intersection test on support functions: each step asks both shapes
+ * for their farthest point in one direction, O(n) each, and 2D pairs
+ * settle in a few steps where SAT projects n1 + n2 vertices on n1 + n2
+ * axes. Any convex shape with a support function works, so circles and
+ * polygons rounded by a radius come for free. EPA then grows the final
+ * simplex out to the penetration depth and normal of an intersecting pair.
+ *
+ * It works in f64 whatever the Scalar (the products of products overflow
+ * 16.16), so pairs that only just touch can come out either way against
+ * find_collision(); geometry_bench counts those apart from real mismatches.
+ */
+
+#define GJK_MAX_ITERATIONS 32
+// a - b has at most n1 + n2 vertices; past this EPA stops short, on a lower bound
+#define EPA_MAX_VERTICES 128
+#define EPA_TOLERANCE 1e-9
+
+/* n points, inflated by radius: a polygon, or with n == 1 a circle */
+typedef struct {
+    const Vector2 *points;
+    usize n;
+    f64 radius;
+} ConvexShape;
+
+typedef struct {
+    f64 nx; // Unit normal from the first shape towards the second
+    f64 ny;
+    f64 depth; // How far to move the second along it to separate them
+} Penetration;
+
+ConvexShape shape_polygon(const Polygon *poly);
+
+ConvexShape shape_circle(const Vector2 *center, f64 radius);
+
+bool gjk_intersect(const ConvexShape *a, const ConvexShape *b);
+
+/* gjk_intersect(), and if they do, the penetration from EPA */
+bool gjk_penetration(const ConvexShape *a, const ConvexShape *b, Penetration *pen);
+
+/* find_collision() through GJK */
+bool find_collision_gjk(Polygon *poly1, Polygon *poly2);
+
+#endif
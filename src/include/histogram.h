@@ -0,0 +1,32 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include "base.h"
+
+/*
+ * Fixed-width bucket histogram of non-negative samples, e.g. latencies in
+ * seconds. The last bucket also takes everything past the range, while
+ * count, mean and max stay exact.
+ */
+
+#define HISTOGRAM_BUCKETS 64
+
+typedef struct {
+    f64 bucket_width;
+    u64 buckets[HISTOGRAM_BUCKETS];
+    u64 count;
+    f64 sum;
+    f64 max;
+} Histogram;
+
+void histogram_init(Histogram *hist, f64 bucket_width);
+
+void histogram_add(Histogram *hist, f64 x);
+
+/* Upper edge of the bucket holding the p-th quantile, 0 <= p <= 1 */
+f64 histogram_percentile(const Histogram *hist, f64 p);
+
+/* Summary and one bar per non-empty bucket, values multiplied by scale */
+void histogram_print(const Histogram *hist, const char *name, f64 scale, const char *unit);
+
+#endif
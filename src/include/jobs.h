@@ -0,0 +1,47 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include "base.h"
+#include "const.h"
+#include "memory_budget.h"
+
+/*
+ * Small work-stealing job system for data-parallel loops within a tick.
+ * jobs_parallel_for() cuts [0, n) into chunks, deals them out in
+ * contiguous runs to one deque per thread, and every thread (the caller
+ * included) pops its own chunks from the bottom and steals from the top of
+ * the others' when it runs dry. It returns once every chunk has run.
+ *
+ * Chunks may run in any order on any thread, so callers that need
+ * deterministic results write into per-thread or per-index buffers and
+ * merge them afterwards. All storage is static; there is one job system
+ * and it must only be driven from one thread.
+ */
+
+// JOBS_MAX_THREADS and JOBS_QUEUE, the chunks a deque holds, are in the
+// capacity profile, see const.h
+
+/* Runs indices [begin, end) of a loop, thread < jobs_threads() */
+typedef void (*JobFn)(void *aux, usize begin, usize end, usize thread);
+
+typedef struct {
+    u64 loops;
+    u64 chunks;
+    u64 steals;
+} JobStats;
+
+void jobs_init(usize threads);
+
+void jobs_quit(void);
+
+usize jobs_threads(void);
+
+/* Runs fn over [0, n) in chunks of at least grain indices */
+void jobs_parallel_for(usize n, usize grain, JobFn fn, void *aux);
+
+JobStats jobs_stats(void);
+
+/* The deques, whose high water is the most chunks dealt to one thread */
+usize jobs_memory(const MemoryPool **pools);
+
+#endif
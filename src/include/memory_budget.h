@@ -0,0 +1,32 @@
+#ifndef _MEMORY_BUDGET_H_
+#define _MEMORY_BUDGET_H_
+
+#include "base.h"
+
+/*
+ * Accounting for the static pools. Each subsystem describes its pools
+ * with the bytes they reserve, the items they have room for and the most
+ * items they have held at once, and hands them out through its own
+ * *_memory() function, so a report lists every pool linked in, touched or
+ * not. The capacities and budgets come from the profile in const.h.
+ */
+
+typedef struct {
+    const char *name;
+    usize bytes;
+    usize capacity;
+    usize high_water;
+} MemoryPool;
+
+/* Record that used items of the pool are taken */
+static inline void memory_use(MemoryPool *pool, usize used)
+{
+    if (used > pool->high_water) {
+        pool->high_water = used;
+    }
+}
+
+/* One line per pool under the subsystem's total, returns the total bytes */
+usize memory_print(const char *subsystem, const MemoryPool *pools, usize n, usize budget);
+
+#endif
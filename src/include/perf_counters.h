@@ -0,0 +1,59 @@
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include "base.h"
+
+/*
+ * Hardware performance counters of the calling thread through Linux
+ * perf_event_open(): cycles, instructions, L1 data cache read misses,
+ * last level cache misses and branch misses, in user code only. They are
+ * opened as one group, so they count over the same intervals and one
+ * read() takes them all. Reads are raw, with the time the group was
+ * enabled and running: if the PMU multiplexes the group, scale the
+ * difference of two reads with counters_scale().
+ *
+ * Counters the machine or the kernel does not offer (virtual machines,
+ * perf_event_paranoid, other systems) are left out and reported as
+ * unavailable, and with none open every read gives zeros.
+ */
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    NUM_COUNTERS,
+} Counter;
+
+extern const char *COUNTER_NAMES[NUM_COUNTERS];
+
+typedef struct {
+    u64 counts[NUM_COUNTERS];
+    u64 enabled; // Nanoseconds the group was enabled
+    u64 running; // and counting, less when multiplexed
+} CounterValues;
+
+/* Open the counters for this thread, returns how many opened */
+usize counters_open(void);
+
+bool counters_active(void);
+
+bool counter_available(Counter counter);
+
+/* Why the first counter that failed to open did, or NULL */
+const char *counters_error(void);
+
+/* Counts since counters_open(), zero for counters that are unavailable */
+void counters_read(CounterValues *values);
+
+/*
+ * Counts between two reads, each scaled by the share of that interval the
+ * group was running. Scaling each interval on its own keeps one interval
+ * of multiplexing from skewing the ones after it.
+ */
+void counters_scale(const CounterValues *from, const CounterValues *to, u64 *counts);
+
+void counters_close(void);
+
+#endif
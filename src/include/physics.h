@@ -0,0 +1,84 @@
+#ifndef _PHYSICS_H_
+#define _PHYSICS_H_
+
+#include "base.h"
+#include "const.h"
+#include "polygon.h"
+#include "memory_budget.h"
+
+/*
+ * Contact response between bodies that move but never spin, like the
+ * asteroids. One physics_step():
+ *
+ *   broad phase   sort and sweep over the x extents, skipping pairs that
+ *                 are both asleep
+ *   narrow phase  GJK/EPA depth and normal of each pair, on the job system
+ *   batching      contacts colored greedily so that no body is in a batch
+ *                 twice, and laid out as arrays batch by batch
+ *   solve         sequential impulses, warm started from the impulse the
+ *                 same pair ended the last step with, then a position
+ *                 correction of what depth is left
+ *
+ * Without spin the impulses act through the centroids, so there are no
+ * contact points and no friction. Within a batch the impulses are
+ * gathered, computed and scattered in three loops, the middle one over
+ * plain arrays with no dependence between iterations; contacts left over
+ * once PHYSICS_MAX_BATCHES are taken are solved one by one. Pairs and
+ * contacts past their capacity are dropped and counted, which bounds the
+ * work of a step however crowded it gets.
+ *
+ * Everything runs in f64 and in a fixed order, so results do not depend
+ * on the number of job threads.
+ */
+
+#define PHYSICS_ITERATIONS 6
+#define PHYSICS_MAX_BATCHES 32
+#define PHYSICS_RESTITUTION 0.6
+#define PHYSICS_BOUNCE_SPEED 10.0 // Slower approaches do not bounce
+#define PHYSICS_SLOP 0.5 // Depth left alone, so resting contacts persist
+#define PHYSICS_CORRECTION 0.4 // Share of the rest of the depth removed per step
+#define PHYSICS_GRAIN 32
+
+// MAX_CONTACTS and PHYSICS_MAX_PAIRS are in the capacity profile, see const.h
+
+typedef struct {
+    u16 id; // Names the body in warm start keys, e.g. its entity slot
+    bool asleep; // Not integrated; cleared when an awake body pushes it
+    Polygon poly;
+    f64 inv_mass; // 0 for immovable
+    f64 vx;
+    f64 vy;
+    f64 dx; // Position correction out
+    f64 dy;
+} Body;
+
+/* Impulse a pair ended a step with, keyed by its ids low << 16 | high */
+typedef struct {
+    u32 key;
+    f32 impulse;
+} WarmContact;
+
+/* The contacts of the last step in key order, kept by the caller */
+typedef struct {
+    WarmContact contacts[MAX_CONTACTS];
+    usize length;
+} ContactCache;
+
+typedef struct {
+    u64 steps;
+    u64 pairs; // From the broad phase
+    u64 contacts;
+    u64 warm; // Contacts that were touching the step before too
+    u64 batches;
+    u64 serial; // Contacts solved one by one past the last batch
+    u64 woken;
+    u64 dropped; // Pairs and contacts past capacity
+} PhysicsStats;
+
+/* Resolve contacts among n bodies, updating velocities and corrections */
+void physics_step(Body *bodies, usize n, ContactCache *cache, PhysicsStats *stats);
+
+/* Broad phase pairs and contact arrays, high water the most in one step */
+usize physics_memory(const MemoryPool **pools);
+
+#endif
@@ -5,11 +5,30 @@
 #include "vector.h"
 #include "const.h"
 
+/*
+ * A view of n vertices stored elsewhere, e.g. in a VertexArena. At most
+ * MAX_POINTS, which sizes the scratch buffers of the renderers.
+ */
 typedef struct {
-    Vector2 points[MAX_POINTS];
+    Vector2 *points;
     usize n;
 } Polygon;
 
+/*
+ * Loops are unrolled for the vertex counts that have kernels, see
+ * poly_has_kernel(). The *_generic versions handle any count and are
+ * exported for benchmarks and cross-checks.
+ */
+#if defined(__clang__)
+#define POLY_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define POLY_UNROLL _Pragma("GCC unroll 16")
+#else
+#define POLY_UNROLL
+#endif
+
+bool poly_has_kernel(usize n);
+
 void poly_translate(Polygon *poly, Vector2 t);
 
 void poly_rotate(Polygon *poly, f64 theta, Vector2 v);
@@ -18,8 +37,18 @@ Vector2 poly_min(Polygon *poly);
 
 Vector2 poly_max(Polygon *poly);
 
-f64 poly_area(Polygon *poly);
+WideScalar poly_area(Polygon *poly);
 
 Vector2 poly_centroid(Polygon *poly);
 
+void poly_translate_generic(Polygon *poly, Vector2 t);
+
+void poly_rotate_generic(Polygon *poly, f64 theta, Vector2 v);
+
+Vector2 poly_min_generic(Polygon *poly);
+
+Vector2 poly_max_generic(Polygon *poly);
+
+Vector2 poly_centroid_generic(Polygon *poly);
+
 #endif
@@ -0,0 +1,28 @@
+#ifndef _QUALITY_GOVERNOR_H_
+#define _QUALITY_GOVERNOR_H_
+
+#include "base.h"
+
+/*
+ * Picks a quality level, 0 (full) to max_level, that holds the cost of a
+ * frame (update plus render) within a budget. A smoothed cost over budget,
+ * or a single frame far over it, lowers quality one level at a time with a
+ * short cooldown; quality only comes back one level after a long run of
+ * frames well under budget. What a level turns down is up to the caller.
+ */
+
+typedef struct {
+    u8 level;
+    u8 max_level;
+    f64 budget;
+    f64 average;
+    usize cooldown;
+    usize calm;
+} QualityGovernor;
+
+void quality_governor_init(QualityGovernor *gov, f64 budget, u8 max_level);
+
+/* Feed the last frame's cost in seconds, returns the level to run at */
+u8 quality_governor_update(QualityGovernor *gov, f64 frame_cost);
+
+#endif
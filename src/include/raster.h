@@ -0,0 +1,57 @@
+#ifndef _RASTER_H_
+#define _RASTER_H_
+
+#include "base.h"
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+#include "color.h"
+#include "memory_budget.h"
+
+/*
+ * Software rasterizer for convex polygons into an in-memory RGBA8
+ * framebuffer. Polygons are binned into screen tiles as they are
+ * submitted and rasterized on raster_flush(), spread by tile across the
+ * threads of the job system (jobs.h). Rasterization uses integer edge
+ * functions with a top-left fill rule, so output is pixel exact
+ * regardless of the thread count or whether the SIMD path is compiled in.
+ */
+
+#define RASTER_TILE 64
+#define RASTER_TILES_X ((WIDTH + RASTER_TILE - 1) / RASTER_TILE)
+#define RASTER_TILES_Y ((HEIGHT + RASTER_TILE - 1) / RASTER_TILE)
+#define RASTER_TILES (RASTER_TILES_X * RASTER_TILES_Y)
+
+// RASTER_MAX_PRIMS and RASTER_MAX_TILE_PRIMS are in the capacity profile,
+// see const.h
+
+/* Pixels are stored as bytes R, G, B, A */
+typedef u32 Pixel;
+
+typedef struct {
+    u64 polygons;
+    u64 pixels;
+    u64 flushes;
+} RasterStats;
+
+void raster_init(void);
+
+void raster_clear(Color c);
+
+void raster_polygon(const Polygon *poly, Color c);
+
+void raster_flush(void);
+
+const Pixel *raster_pixels(void);
+
+RasterStats raster_stats(void);
+
+/* Framebuffer, primitive and tile bin pools, returns how many */
+usize raster_memory(const MemoryPool **pools);
+
+/* FNV-1a hash of the framebuffer, for golden image comparisons */
+u64 raster_hash(void);
+
+bool raster_write_ppm(const char *path);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include "base.h"
+#include "const.h"
+#include "memory_budget.h"
+
+/*
+ * Seekable recording of a session. Every interval ticks the full game
+ * state is written as a keyframe, and between keyframes only each tick's
+ * input; an index of the keyframes closes the file:
+ *
+ *   ReplayHeader
+ *   state at first_tick, inputs of first_tick .. first_tick + interval - 1
+ *   state at first_tick + interval, its inputs
+ *   ...
+ *   ReplayKeyframe per keyframe
+ *   ReplayFooter
+ *
+ * The state and input are opaque fixed-size records here. The game's state
+ * holds no pointers, so a keyframe is its bytes, and any tick is reached
+ * by loading the keyframe before it and resimulating fewer than interval
+ * ticks. Files are read through mmap, so a seek only touches the pages of
+ * one keyframe and its inputs.
+ *
+ * A file only describes the build that wrote it: the header has the
+ * record sizes and a build tag, and the reader refuses any other. Past
+ * REPLAY_MAX_KEYFRAMES keyframes the rest of the session is inputs only.
+ * A file whose writer never closed it has no index; the reader rebuilds
+ * one from the layout, up to the last whole tick.
+ */
+
+#define REPLAY_MAGIC 0x59504c52
+#define REPLAY_VERSION 1
+#define REPLAY_KEYFRAME_TICKS 300
+#define REPLAY_TAG_BYTES 32
+// REPLAY_MAX_KEYFRAMES, the entries of the index, is in the capacity profile
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 state_bytes;
+    u32 input_bytes;
+    u32 interval; // Ticks between keyframes
+    u32 rules; // Settings outside the state that change the game
+    u64 first_tick;
+    char tag[REPLAY_TAG_BYTES];
+} ReplayHeader;
+
+typedef struct {
+    u64 tick;
+    u64 offset; // Of the state, its inputs follow it
+} ReplayKeyframe;
+
+typedef struct {
+    u64 index_offset;
+    u64 keyframes;
+    u64 ticks; // Inputs recorded, from first_tick on
+    u32 magic;
+    u32 reserved;
+} ReplayFooter;
+
+typedef struct {
+    u64 ticks;
+    u64 keyframes;
+    u64 bytes;
+    bool failed; // A write failed and recording stopped there
+} ReplayStats;
+
+/* Writer side */
+
+bool replay_open(
+    const char *path,
+    usize state_bytes,
+    usize input_bytes,
+    u32 interval,
+    u32 rules,
+    const char *tag);
+
+bool replay_active(void);
+
+/*
+ * Record the input applied to the state at tick. Ticks must follow each
+ * other; state is only read when tick is due a keyframe.
+ */
+void replay_record(u64 tick, const void *state, const void *input);
+
+/* Write the index and footer and close the file */
+ReplayStats replay_close(void);
+
+/* The keyframe index, returns how many pools */
+usize replay_memory(const MemoryPool **pools);
+
+/* Reader side */
+
+typedef struct {
+    const u8 *data;
+    usize length;
+    const ReplayHeader *header;
+    const ReplayKeyframe *index;
+    u64 keyframes;
+    u64 ticks;
+    bool recovered; // The file had no footer and the index was rebuilt
+} Replay;
+
+/* Map a file written by this build, false with a message on stderr if not */
+bool replay_load(
+    const char *path,
+    Replay *replay,
+    usize state_bytes,
+    usize input_bytes,
+    const char *tag);
+
+void replay_unload(Replay *replay);
+
+/* One past the last tick with an input; its state is the end of the session */
+static inline u64 replay_end(const Replay *replay)
+{
+    return replay->header->first_tick + replay->ticks;
+}
+
+/* The last keyframe at or before tick, NULL if tick is not recorded */
+const ReplayKeyframe *replay_keyframe(const Replay *replay, u64 tick);
+
+static inline const void *replay_state(const Replay *replay, const ReplayKeyframe *key)
+{
+    return replay->data + key->offset;
+}
+
+/* The input of tick, NULL if tick is not recorded */
+const void *replay_input(const Replay *replay, u64 tick);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef _SCALAR_H_
+#define _SCALAR_H_
+
+#include "base.h"
+
+/*
+ * Scalar type of the physics and geometry library, picked at compile time:
+ *
+ *   default        f64
+ *   -DSCALAR_F32   f32, half the memory traffic and twice the SIMD lanes
+ *   -DSCALAR_FIXED 16.16 fixed point in an i32, bit-exact on every machine
+ *
+ * Products of two scalars (dot products, cross products, areas) are
+ * returned as WideScalar so that fixed point has room for them. In fixed
+ * point a WideScalar is an i64 that still has 16 fractional bits.
+ *
+ * Code outside the library works in f64 and converts at the boundary with
+ * vec(), scalar_from_f64() and scalar_to_f64().
+ */
+
+#if defined(SCALAR_FIXED)
+
+typedef i32 Scalar;
+typedef i64 WideScalar;
+
+#define SCALAR_FRAC_BITS 16
+#define SCALAR_ONE (1 << SCALAR_FRAC_BITS)
+#define SCALAR_C(x) ((Scalar) ((x) * (f64) SCALAR_ONE))
+#define SCALAR_MAX INT32_MAX
+#define SCALAR_MIN INT32_MIN
+#define SCALAR_NAME "fixed16.16"
+
+static inline Scalar scalar_from_f64(f64 x)
+{
+    return (Scalar) llround(x * SCALAR_ONE);
+}
+
+static inline f64 scalar_to_f64(Scalar x)
+{
+    return (f64) x / SCALAR_ONE;
+}
+
+static inline f64 wide_to_f64(WideScalar x)
+{
+    return (f64) x / SCALAR_ONE;
+}
+
+static inline Scalar scalar_mul(Scalar a, Scalar b)
+{
+    return (Scalar) (((i64) a * b) >> SCALAR_FRAC_BITS);
+}
+
+static inline WideScalar wide_mul(Scalar a, Scalar b)
+{
+    return ((i64) a * b) >> SCALAR_FRAC_BITS;
+}
+
+static inline WideScalar wide_mul_scalar(WideScalar a, Scalar b)
+{
+    return (a * b) >> SCALAR_FRAC_BITS;
+}
+
+/*
+ * Saturates rather than wraps when the quotient is out of range, as it is
+ * for projections onto axes only a few raw units long. Saturating keeps
+ * the order of quotients, so projected bounds that overlap still do.
+ */
+static inline Scalar wide_div(WideScalar a, WideScalar b)
+{
+    i64 q = (a * SCALAR_ONE) / b;
+    return q > SCALAR_MAX ? SCALAR_MAX : q < SCALAR_MIN ? SCALAR_MIN : (Scalar) q;
+}
+
+static inline WideScalar wide_abs(WideScalar x)
+{
+    return x < 0 ? -x : x;
+}
+
+/*
+ * sin(theta) with only integer arithmetic after reducing theta to a 32-bit
+ * phase, so results do not depend on the platform's libm. Uses the odd
+ * Taylor polynomial of sin(pi/2 x) up to x^9 in Q30 on a quarter turn;
+ * the maximum error is about 6e-6, below the 1.5e-5 resolution of 16.16.
+ */
+static inline Scalar scalar_sin_phase(u32 phase)
+{
+    const i64 one = (i64) 1 << 30;
+    const i64 a1 = 1686629713;  // pi/2
+    const i64 a3 = -693598668;  // -(pi/2)^3 / 3!
+    const i64 a5 = 85569306;    // (pi/2)^5 / 5!
+    const i64 a7 = -5026995;    // -(pi/2)^7 / 7!
+    const i64 a9 = 172272;      // (pi/2)^9 / 9!
+    u32 quadrant = phase >> 30;
+    i64 x = phase & (one - 1);
+    if (quadrant & 1) {
+        x = one - x;
+    }
+    i64 x2 = (x * x) >> 30;
+    i64 p = a9;
+    p = a7 + ((p * x2) >> 30);
+    p = a5 + ((p * x2) >> 30);
+    p = a3 + ((p * x2) >> 30);
+    p = a1 + ((p * x2) >> 30);
+    p = (p * x) >> 30;
+    Scalar s = (Scalar) ((p + (1 << 13)) >> 14);
+    return quadrant & 2 ? -s : s;
+}
+
+static inline u32 scalar_phase(f64 theta)
+{
+    f64 turns = theta * (1.0 / (2.0 * M_PI));
+    turns -= floor(turns);
+    return (u32) (u64) (turns * 4294967296.0);
+}
+
+static inline Scalar scalar_sin(f64 theta)
+{
+    return scalar_sin_phase(scalar_phase(theta));
+}
+
+static inline Scalar scalar_cos(f64 theta)
+{
+    return scalar_sin_phase(scalar_phase(theta) + (1u << 30));
+}
+
+#else
+
+#if defined(SCALAR_F32)
+typedef f32 Scalar;
+typedef f32 WideScalar;
+#define SCALAR_NAME "f32"
+#define SCALAR_SIN sinf
+#define SCALAR_COS cosf
+#else
+typedef f64 Scalar;
+typedef f64 WideScalar;
+#define SCALAR_NAME "f64"
+#define SCALAR_SIN sin
+#define SCALAR_COS cos
+#endif
+
+#define SCALAR_ONE 1
+#define SCALAR_C(x) ((Scalar) (x))
+#define SCALAR_MAX INFINITY
+#define SCALAR_MIN (-INFINITY)
+
+static inline Scalar scalar_from_f64(f64 x)
+{
+    return (Scalar) x;
+}
+
+static inline f64 scalar_to_f64(Scalar x)
+{
+    return x;
+}
+
+static inline f64 wide_to_f64(WideScalar x)
+{
+    return x;
+}
+
+static inline Scalar scalar_mul(Scalar a, Scalar b)
+{
+    return a * b;
+}
+
+static inline WideScalar wide_mul(Scalar a, Scalar b)
+{
+    return a * b;
+}
+
+static inline WideScalar wide_mul_scalar(WideScalar a, Scalar b)
+{
+    return a * b;
+}
+
+static inline Scalar wide_div(WideScalar a, WideScalar b)
+{
+    return a / b;
+}
+
+static inline WideScalar wide_abs(WideScalar x)
+{
+    return x < 0 ? -x : x;
+}
+
+static inline Scalar scalar_sin(f64 theta)
+{
+    return SCALAR_SIN((Scalar) theta);
+}
+
+static inline Scalar scalar_cos(f64 theta)
+{
+    return SCALAR_COS((Scalar) theta);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _SCALE_CONTROLLER_H_
+#define _SCALE_CONTROLLER_H_
+
+#include "base.h"
+
+/*
+ * Picks a render scale that holds the frame time near a budget. Fill cost
+ * grows with the square of the scale, so when the smoothed frame time is
+ * over budget the scale drops by sqrt(budget / time); when there is plenty
+ * of headroom it creeps back up. The gap between the two thresholds and a
+ * cooldown after every change keep it from oscillating.
+ */
+
+typedef struct {
+    f64 scale;
+    f64 min_scale;
+    f64 max_scale;
+    f64 budget;
+    f64 average;
+    usize cooldown;
+} ScaleController;
+
+void scale_controller_init(ScaleController *ctrl, f64 budget, f64 min_scale);
+
+/* Feed the last frame's time in seconds, returns the scale to render at */
+f64 scale_controller_update(ScaleController *ctrl, f64 frame_time);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _SCENARIO_H_
+#define _SCENARIO_H_
+
+#include "base.h"
+
+/*
+ * Stress scenario for soak runs, read from a text file with one setting
+ * per line and '#' comments:
+ *
+ *   duration 36000        ticks to run
+ *   asteroids 40          asteroids spawned by every (re)start
+ *   max_asteroids 80      cap for asteroids respawned when one is destroyed
+ *   restart_every 3600    restart the game every so many ticks, 0 for never
+ *   wave 600 20           spawn 20 asteroids at tick 600
+ *   wave 1200 5 300       spawn 5 at tick 1200 and every 300 ticks after
+ *
+ * Settings missing from the file keep the values they had before loading.
+ */
+
+#define SCENARIO_MAX_WAVES 32
+
+typedef struct {
+    u64 tick;
+    u64 period;
+    usize count;
+} ScenarioWave;
+
+typedef struct {
+    u64 duration;
+    usize asteroids;
+    usize max_asteroids;
+    u64 restart_every;
+    ScenarioWave waves[SCENARIO_MAX_WAVES];
+    usize num_waves;
+} Scenario;
+
+bool scenario_load(const char *path, Scenario *scenario);
+
+/* Number of asteroids the waves spawn at a tick */
+usize scenario_spawns(const Scenario *scenario, u64 tick);
+
+#endif
@@ -2,6 +2,9 @@
 #define _SDL_WRAPPER_H_
 
 #include "base.h"
+#include "polygon.h"
+#include "color.h"
+#include "memory_budget.h"
 
 typedef enum {
     LEFT_ARROW = 1,
@@ -16,10 +19,15 @@ typedef enum {
     KEY_RELEASED
 } KeyEventType;
 
-typedef void (*KeyHandler)(u8 key, KeyEventType type, f64 held_time, void *aux);
+/* timestamp is when the event arrived, on the timer_now() clock */
+typedef void (*KeyHandler)(
+        u8 key, KeyEventType type, f64 held_time, f64 timestamp, void *aux);
 
 void sdl_render_score(usize score);
 
+/* Silence every sound effect, e.g. while resimulating past ticks */
+void sdl_mute(bool muted);
+
 void sdl_play_start(void);
 
 void sdl_play_shoot(void);
@@ -42,10 +50,48 @@ void sdl_clear(void);
 
 void sdl_draw_polygon(const Polygon *poly, Color c);
 
+/*
+ * Draw a polygon whose shape never changes from a texture atlas. shape is
+ * a nonzero key identifying the shape; the first draw of a key rasterizes
+ * poly, unrotated by theta around cent, into the atlas. Returns false if
+ * the sprite could not be drawn and the caller should use
+ * sdl_draw_polygon() instead.
+ */
+bool sdl_draw_sprite(u32 shape, const Polygon *poly, Vector2 cent, f64 theta, Color c);
+
+/* Free the atlas space of a shape that will not be drawn again */
+void sdl_release_sprite(u32 shape);
+
+/* Copy the frame drawn so far as WIDTH * HEIGHT RGBA pixels, before sdl_show() */
+void sdl_read_frame(u8 *rgba);
+
 void sdl_show(void);
 
+/*
+ * Draw into an offscreen target at a fraction of the window resolution,
+ * which sdl_show() upscales to the window in one copy.
+ */
+void sdl_set_render_scale(f64 scale);
+
+f64 sdl_render_scale(void);
+
+/*
+ * Seconds the last frame spent issuing draw calls on the CPU, and waiting
+ * in present for the GPU to finish it.
+ */
+void sdl_frame_times(f64 *cpu, f64 *gpu);
+
+/* Text drawn over the next frame at full resolution, NULL for none */
+void sdl_set_debug_text(const char *text);
+
 void sdl_quit(void);
 
 f64 time_since_last_tick(void);
 
+/* True when frames are not paced by a display and nothing is shown */
+bool sdl_is_headless(void);
+
+/* The backend's render pools, returns how many */
+usize sdl_memory(const MemoryPool **pools);
+
 #endif
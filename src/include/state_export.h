@@ -0,0 +1,74 @@
+#ifndef _STATE_EXPORT_H_
+#define _STATE_EXPORT_H_
+
+#include "base.h"
+#include "const.h"
+
+/*
+ * Versioned, fixed-layout snapshot of the game published every tick into a
+ * POSIX shared memory segment. The segment is guarded by a seqlock: the
+ * game never waits on readers, and readers retry if they raced a write.
+ * Any change to the structs below must bump STATE_EXPORT_VERSION.
+ */
+
+#define STATE_EXPORT_NAME "/spacetime_state"
+#define STATE_EXPORT_MAGIC 0x58455453
+#define STATE_EXPORT_VERSION 2
+
+typedef enum {
+    EXPORT_PLAYER = 0,
+    EXPORT_ASTEROID = 1,
+    EXPORT_BULLET = 2,
+    EXPORT_PARTICLE = 3,
+} ExportKind;
+
+typedef struct {
+    u32 id;
+    u32 kind;
+    f64 x;
+    f64 y;
+    f64 theta;
+    f64 vx;
+    f64 vy;
+} ExportEntity;
+
+typedef struct {
+    u64 tick;
+    u64 score;
+    u32 status;
+    u32 count;
+    u32 quality; // Level of the quality governor, 0 is full quality
+    u32 reserved;
+    ExportEntity entities[MAX_ENTITIES];
+} ExportFrame;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 frame_size;
+    u32 capacity;
+    u64 seq;
+    ExportFrame frame;
+} ExportSegment;
+
+/* Publisher side, used by the game */
+
+bool export_open(const char *name);
+
+/* Start writing a frame; readers see it only after export_end() */
+ExportFrame *export_begin(void);
+
+void export_end(void);
+
+void export_close(void);
+
+/* Reader side */
+
+const ExportSegment *export_attach(const char *name);
+
+/* Copy a consistent frame out of the segment, false if none could be read */
+bool export_read(const ExportSegment *segment, ExportFrame *frame);
+
+void export_detach(const ExportSegment *segment);
+
+#endif
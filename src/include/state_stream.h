@@ -0,0 +1,134 @@
+#ifndef _STATE_STREAM_H_
+#define _STATE_STREAM_H_
+
+#include "base.h"
+#include "const.h"
+#include "state_export.h"
+#include "memory_budget.h"
+
+/*
+ * Delta-compressed stream of ExportFrames for spectators and archives.
+ * Transforms are quantized (1/16 px, 1/16 px/s, 65536 steps per turn)
+ * and every frame after a keyframe only carries removed entities, spawned
+ * entities and the fields that changed, as varints of the integer
+ * difference. Decoding is exact up to that quantization and never drifts.
+ *
+ * The stream starts with a STREAM_HEADER_BYTES header, then each frame is
+ * a varint payload length followed by the payload:
+ *
+ *   u8      flags, STREAM_KEYFRAME clears every entity first
+ *   varint  tick delta (absolute on keyframes)
+ *   zigzag  score delta (absolute on keyframes)
+ *   u8      status
+ *   u8      quality level
+ *   varint  removed count, then ids
+ *   varint  spawned count, then id, u8 kind, x, y, angle, vx, vy
+ *   varint  moved count, then id, u8 field mask, deltas of those fields
+ *
+ * The publisher copies frames into a small pool and a background thread
+ * encodes and writes them to a file or a Unix domain socket, so the game
+ * only pays for the copy. Frames are dropped rather than waited for when
+ * the writer falls behind; deltas are always against the last frame sent.
+ */
+
+#define STREAM_MAGIC 0x52545353
+#define STREAM_VERSION 2
+#define STREAM_HEADER_BYTES 8
+#define STREAM_POS_SCALE 16
+#define STREAM_VEL_SCALE 16
+#define STREAM_ANGLE_STEPS 65536
+#define STREAM_KEYFRAME_INTERVAL 600
+// STREAM_POOL, the frames in flight to the writer, is in the capacity profile
+#define STREAM_MAX_FRAME_BYTES (64 * MAX_ENTITIES + 64)
+
+#define STREAM_KEYFRAME 1
+
+typedef struct {
+    i32 x;
+    i32 y;
+    u32 angle;
+    i32 vx;
+    i32 vy;
+    u32 kind;
+} StreamEntity;
+
+typedef struct {
+    StreamEntity entities[MAX_ENTITIES];
+    bool live[MAX_ENTITIES];
+    u64 tick;
+    u64 score;
+    u32 status;
+    u32 quality;
+} StreamState;
+
+typedef struct {
+    StreamState prev;
+    u64 frames;
+    // Scratch lists of one encode
+    u32 removed[MAX_ENTITIES];
+    u32 spawned[MAX_ENTITIES];
+    u32 moved[MAX_ENTITIES];
+    u8 masks[MAX_ENTITIES];
+    bool seen[MAX_ENTITIES];
+} StreamEncoder;
+
+typedef struct {
+    StreamState state;
+    bool header_done;
+} StreamDecoder;
+
+typedef enum {
+    STREAM_FRAME,
+    STREAM_NEED_MORE,
+    STREAM_ERROR,
+} StreamResult;
+
+typedef struct {
+    u64 frames;
+    u64 dropped;
+    u64 bytes;
+} StreamStats;
+
+/* Publisher side: target is a file path or "unix:" and a socket path */
+
+bool stream_open(const char *target);
+
+bool stream_active(void);
+
+/* A free frame to fill, or NULL (and a dropped frame) if none is free */
+ExportFrame *stream_acquire(void);
+
+void stream_submit(ExportFrame *frame);
+
+StreamStats stream_close(void);
+
+/* The frame pool and the writer's encoder, returns how many pools */
+usize stream_memory(const MemoryPool **pools);
+
+/* Codec, also used directly by benchmarks and readers */
+
+usize stream_write_header(u8 *out);
+
+void stream_encoder_init(StreamEncoder *enc);
+
+/* Encode a frame with its length prefix, returns the bytes written */
+usize stream_encode(StreamEncoder *enc, const ExportFrame *frame, u8 *out);
+
+void stream_decoder_init(StreamDecoder *dec);
+
+/*
+ * Decode the header if it has not been seen yet, then one frame. On
+ * STREAM_FRAME, *consumed bytes were used and frame holds the result with
+ * entities ordered by kind, then id.
+ */
+StreamResult stream_decode(
+    StreamDecoder *dec,
+    const u8 *data,
+    usize length,
+    usize *consumed,
+    ExportFrame *frame);
+
+/* Round a frame through the quantization, for comparing with decoded ones */
+void stream_quantize(ExportFrame *frame);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "base.h"
+
+/* Seconds on a monotonic clock, for measuring intervals */
+f64 timer_now(void);
+
+#endif
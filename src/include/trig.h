@@ -0,0 +1,104 @@
+#ifndef _TRIG_H_
+#define _TRIG_H_
+
+#include "base.h"
+#include "scalar.h"
+
+/*
+ * Sine and cosine for the geometry library and the game, computed
+ * together. By default they are libm's sin and cos (the integer
+ * polynomial in fixed point), so results are exactly what they were.
+ * Building with -DFAST_TRIG switches the f64 and f32 modes to
+ * trig_sincos_fast(): one branch-free reduction to [-pi/4, pi/4] shared
+ * by both, then the Cephes minimax polynomials of degree 13 (sine) and 14
+ * (cosine). The absolute error is below TRIG_FAST_MAX_ERROR for
+ * |theta| <= 1e5 (geometry_bench measures it against libm), and being
+ * plain arithmetic it does not depend on the platform's libm.
+ *
+ * trig_rotation() caches the rotation of recent angles per thread, since
+ * most rotations repeat: the separating axis, the fixed steps of spawned
+ * outlines, omega * dt of spinning entities. Cached values are the ones
+ * that would have been computed, so the cache never changes results.
+ */
+
+#define TRIG_FAST_MAX_ERROR 5e-16
+#define TRIG_CACHE_BITS 6
+#define TRIG_CACHE_SLOTS (1 << TRIG_CACHE_BITS)
+
+typedef struct {
+    Scalar c;
+    Scalar s;
+} Rotation;
+
+typedef struct {
+    u64 hits;
+    u64 misses;
+} TrigStats;
+
+static inline void trig_sincos_libm(f64 theta, f64 *s, f64 *c)
+{
+    *s = sin(theta);
+    *c = cos(theta);
+}
+
+static inline void trig_sincos_fast(f64 theta, f64 *s, f64 *c)
+{
+    // Nearest multiple of pi/2, subtracted in three parts (Cody-Waite)
+    const f64 pio2_1 = 1.57079632673412561417e+00;
+    const f64 pio2_2 = 6.07710050630396597660e-11;
+    const f64 pio2_3 = 2.02226624879595063154e-21;
+    f64 kf = theta * M_2_PI;
+    i64 k = (i64) (kf + (kf < 0.0 ? -0.5 : 0.5));
+    f64 x = ((theta - k * pio2_1) - k * pio2_2) - k * pio2_3;
+    f64 z = x * x;
+
+    f64 ps = 1.58962301576546568060e-10;
+    ps = ps * z - 2.50507477628578072866e-8;
+    ps = ps * z + 2.75573136213857245213e-6;
+    ps = ps * z - 1.98412698295895385996e-4;
+    ps = ps * z + 8.33333333332211858878e-3;
+    ps = ps * z - 1.66666666666666307295e-1;
+    f64 sin_x = x + x * z * ps;
+
+    f64 pc = -1.13585365213876817300e-11;
+    pc = pc * z + 2.08757008419747316778e-9;
+    pc = pc * z - 2.75573141792967388112e-7;
+    pc = pc * z + 2.48015872888517045348e-5;
+    pc = pc * z - 1.38888888888730564116e-3;
+    pc = pc * z + 4.16666666666665929218e-2;
+    f64 cos_x = 1.0 - 0.5 * z + z * z * pc;
+
+    // Quadrant by selects rather than branches, angles are rarely sorted
+    f64 a = k & 1 ? cos_x : sin_x;
+    f64 b = k & 1 ? sin_x : cos_x;
+    *s = k & 2 ? -a : a;
+    *c = (k + 1) & 2 ? -b : b;
+}
+
+static inline void trig_sincos(f64 theta, f64 *s, f64 *c)
+{
+#if defined(FAST_TRIG)
+    trig_sincos_fast(theta, s, c);
+#else
+    trig_sincos_libm(theta, s, c);
+#endif
+}
+
+/* Uncached rotation by theta in the scalar type */
+static inline Rotation trig_rotation_uncached(f64 theta)
+{
+#if defined(FAST_TRIG) && !defined(SCALAR_FIXED)
+    f64 s, c;
+    trig_sincos_fast(theta, &s, &c);
+    return (Rotation) { .c = (Scalar) c, .s = (Scalar) s };
+#else
+    return (Rotation) { .c = scalar_cos(theta), .s = scalar_sin(theta) };
+#endif
+}
+
+Rotation trig_rotation(f64 theta);
+
+/* Cache hits and misses of the calling thread */
+TrigStats trig_stats(void);
+
+#endif
@@ -2,10 +2,11 @@
 #define _VECTOR_H_
 
 #include "base.h"
+#include "scalar.h"
 
 typedef struct {
-    f64 x;
-    f64 y;
+    Scalar x;
+    Scalar y;
 } Vector2;
 
 Vector2 vec(f64 x, f64 y);
@@ -16,9 +17,9 @@ Vector2 vec_add(Vector2 v1, Vector2 v2);
 
 Vector2 vec_sub(Vector2 v1, Vector2 v2);
 
-f64 vec_cross(Vector2 v1, Vector2 v2);
+WideScalar vec_cross(Vector2 v1, Vector2 v2);
 
-f64 vec_dot(Vector2 v1, Vector2 v2);
+WideScalar vec_dot(Vector2 v1, Vector2 v2);
 
 Vector2 vec_proj(Vector2 v, Vector2 u);
 
@@ -0,0 +1,49 @@
+#ifndef _VERTEX_ARENA_H_
+#define _VERTEX_ARENA_H_
+
+#include "base.h"
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+
+/*
+ * Fixed-size pool of vertices that entities take contiguous ranges from,
+ * so a 4-vertex shape costs 4 vertices rather than MAX_POINTS. Freed
+ * ranges are kept sorted and merged with their neighbours, and allocation
+ * takes the first free range that fits before growing the used prefix.
+ *
+ * The arena holds indices rather than pointers, so a struct embedding it
+ * can still be copied as plain bytes; arena_poly() builds a Polygon view
+ * that is valid until the range is freed or the arena moves.
+ */
+
+_Static_assert(ARENA_VERTICES <= UINT16_MAX, "VertexRange holds u16 indices");
+
+typedef struct {
+    u16 start;
+    u16 n;
+} VertexRange;
+
+typedef struct {
+    Vector2 vertices[ARENA_VERTICES];
+    // Sorted by start, never adjacent to each other or to top
+    VertexRange free_ranges[MAX_ENTITIES];
+    usize free_length;
+    usize top;
+    usize used;
+    usize high_water;
+} VertexArena;
+
+void arena_reset(VertexArena *arena);
+
+bool arena_alloc(VertexArena *arena, usize n, VertexRange *range);
+
+void arena_free(VertexArena *arena, VertexRange range);
+
+/* Whether the free list is sorted, merged and accounts for every vertex */
+bool arena_check(const VertexArena *arena);
+
+/* The view is writable only when the arena is */
+Polygon arena_poly(const VertexArena *arena, VertexRange range);
+
+#endif
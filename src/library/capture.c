@@ -0,0 +1,190 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "capture.h"
+
+typedef enum {
+    CAPTURE_Y4M,
+    CAPTURE_RAW,
+} CaptureFormat;
+
+static u8 frames[CAPTURE_POOL][CAPTURE_FRAME_BYTES];
+static u8 planes[3][WIDTH * HEIGHT];
+static usize free_frames[CAPTURE_POOL];
+static usize num_free;
+static usize queue[CAPTURE_POOL];
+static usize queue_head;
+static usize queue_length;
+
+static bool active;
+static bool stopping;
+static FILE *file;
+static CaptureFormat format;
+static CaptureStats stats;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t released = PTHREAD_COND_INITIALIZER;
+
+// The planes are Y4M conversion scratch, used by one frame at a time
+static MemoryPool pool = { "capture frames", sizeof(frames) + sizeof(planes), CAPTURE_POOL, 0 };
+_Static_assert(sizeof(frames) + sizeof(planes) <= MEMORY_BUDGET_IO,
+        "capture frames exceed the I/O budget");
+
+/* Only the writer thread writes once it is started */
+static void put(const void *data, usize bytes)
+{
+    if (stats.failed) {
+        return;
+    }
+    if (fwrite(data, 1, bytes, file) != bytes) {
+        stats.failed = true;
+    }
+}
+
+static u8 clamp_u8(i32 x)
+{
+    return x < 0 ? 0 : x > 255 ? 255 : x;
+}
+
+/*
+ * BT.601 full range RGB -> YCbCr in 8.8 fixed point. The chroma weights
+ * round to 128, so pure blue and pure red would give 256 and are clamped.
+ */
+static void write_y4m_frame(const u8 *rgba)
+{
+    if (stats.failed) {
+        return;
+    }
+    for (usize i = 0; i < WIDTH * HEIGHT; i++) {
+        i32 r = rgba[4 * i];
+        i32 g = rgba[4 * i + 1];
+        i32 b = rgba[4 * i + 2];
+        planes[0][i] = (77 * r + 150 * g + 29 * b + 128) >> 8;
+        planes[1][i] = clamp_u8(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+        planes[2][i] = clamp_u8(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+    }
+    put("FRAME\n", 6);
+    put(planes, sizeof(planes));
+}
+
+static void *capture_writer(void *aux)
+{
+    (void) aux;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (queue_length == 0 && !stopping) {
+            pthread_cond_wait(&queued, &lock);
+        }
+        if (queue_length == 0) {
+            break;
+        }
+        usize idx = queue[queue_head];
+        queue_head = (queue_head + 1) % CAPTURE_POOL;
+        queue_length -= 1;
+        pthread_mutex_unlock(&lock);
+
+        // After a failure frames are still released without being written,
+        // so the game never waits on a writer that has stopped
+        if (format == CAPTURE_Y4M) {
+            write_y4m_frame(frames[idx]);
+        } else {
+            put(frames[idx], CAPTURE_FRAME_BYTES);
+        }
+
+        pthread_mutex_lock(&lock);
+        free_frames[num_free] = idx;
+        num_free += 1;
+        stats.written += !stats.failed;
+        pthread_cond_signal(&released);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+bool capture_start(const char *path, u32 fps)
+{
+    assert(!active);
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    usize len = strlen(path);
+    format = len > 5 && !strcmp(path + len - 5, ".rgba") ? CAPTURE_RAW : CAPTURE_Y4M;
+    memset(&stats, 0, sizeof(stats));
+    if (format == CAPTURE_Y4M) {
+        char header[64];
+        usize bytes = snprintf(header, sizeof(header),
+                "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", WIDTH, HEIGHT, fps);
+        put(header, bytes);
+    }
+
+    for (usize i = 0; i < CAPTURE_POOL; i++) {
+        free_frames[i] = i;
+    }
+    num_free = CAPTURE_POOL;
+    queue_head = 0;
+    queue_length = 0;
+    stopping = false;
+    if (pthread_create(&writer, NULL, capture_writer, NULL)) {
+        fclose(file);
+        return false;
+    }
+    active = true;
+    return true;
+}
+
+bool capture_active(void)
+{
+    return active;
+}
+
+u8 *capture_acquire(bool wait)
+{
+    pthread_mutex_lock(&lock);
+    while (wait && num_free == 0) {
+        pthread_cond_wait(&released, &lock);
+    }
+    u8 *frame = NULL;
+    if (num_free > 0) {
+        num_free -= 1;
+        frame = frames[free_frames[num_free]];
+        memory_use(&pool, CAPTURE_POOL - num_free);
+    } else {
+        stats.dropped += 1;
+    }
+    pthread_mutex_unlock(&lock);
+    return frame;
+}
+
+void capture_submit(u8 *frame)
+{
+    usize idx = (frame - frames[0]) / CAPTURE_FRAME_BYTES;
+    assert(idx < CAPTURE_POOL);
+    pthread_mutex_lock(&lock);
+    queue[(queue_head + queue_length) % CAPTURE_POOL] = idx;
+    queue_length += 1;
+    pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&lock);
+}
+
+CaptureStats capture_stop(void)
+{
+    assert(active);
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    if (fclose(file)) {
+        stats.failed = true;
+    }
+    active = false;
+    return stats;
+}
+
+usize capture_memory(const MemoryPool **pools)
+{
+    *pools = &pool;
+    return 1;
+}
@@ -1,16 +1,25 @@
 #include "collision.h"
+#include "gjk.h"
 #include "vector.h"
+#include "trig.h"
 
 typedef struct {
-    f64 min;
-    f64 max;
+    Scalar min;
+    Scalar max;
 } Bounds;
 
-/* Compute the min and max x-values of projecting poly onto u */
+/*
+ * Compute the min and max x-values of projecting poly onto u. An axis too
+ * short to project onto, which in 16.16 is any edge under 1/256 px, puts
+ * every point at 0 and so separates nothing, rather than divide by zero.
+ */
 Bounds get_bounds(Polygon *poly, Vector2 u)
 {
-    f64 min = INFINITY;
-    f64 max = -INFINITY;
+    Scalar min = SCALAR_MAX;
+    Scalar max = SCALAR_MIN;
+    if (!(vec_dot(u, u) > 0)) {
+        return (Bounds) { .min = 0, .max = 0 };
+    }
     for (usize i = 0; i < poly->n; i++) {
         Vector2 proj = vec_proj(poly->points[i], u);
         if (proj.x < min) {
@@ -33,21 +42,195 @@ bool axes_overlap(Polygon *poly1, Polygon *poly2, Vector2 u)
             (b2.max >= b1.min && b2.min <= b1.max));
 }
 
-/* Iterate through projection vectors in poly */
-bool find_collision_shape(Polygon *poly, Polygon *poly1, Polygon *poly2)
+/* Index of the first edge of poly that separates poly1 and poly2, or n */
+usize find_collision_shape(Polygon *poly, Polygon *poly1, Polygon *poly2)
 {
     for (usize i = 0; i < poly->n; i++) {
         Vector2 u = vec_rotate(
                 M_PI / 2.0, vec_sub(poly->points[i], poly->points[(i+1) % poly->n]));
         if (!axes_overlap(poly1, poly2, u)) {
-            return false;
+            return i;
         }
     }
-    return true;
+    return poly->n;
+}
+
+/*
+ * Separating axis kernels for pairs of vertex counts that have polygon
+ * kernels, unrolled like those and giving exactly what the generic path
+ * gives. The axes are edges turned by vec_rotate(M_PI / 2, ...), and the
+ * bounds are the x of vec_proj() onto them, but since that is monotonic in
+ * the dot product with the axis only the two extreme vertices are divided
+ * and scaled, not all n. Degenerate axes take the generic path.
+ */
+static Bounds __attribute__((noinline)) get_bounds_degenerate(
+    const Vector2 *p, usize n, Vector2 u)
+{
+    return get_bounds(&(Polygon) { .points = (Vector2 *) p, .n = n }, u);
+}
+
+#define SAT_BOUNDS(N) \
+    static inline Bounds sat_bounds_##N(const Vector2 *p, Vector2 u) \
+    { \
+        WideScalar uu = wide_mul(u.x, u.x) + wide_mul(u.y, u.y); \
+        WideScalar lo = wide_mul(p[0].x, u.x) + wide_mul(p[0].y, u.y); \
+        WideScalar hi = lo; \
+        POLY_UNROLL \
+        for (usize i = 1; i < N; i++) { \
+            WideScalar pu = wide_mul(p[i].x, u.x) + wide_mul(p[i].y, u.y); \
+            if (pu < lo) lo = pu; \
+            if (pu > hi) hi = pu; \
+        } \
+        if (!(uu > 0)) { \
+            return get_bounds_degenerate(p, N, u); \
+        } \
+        Scalar a = scalar_mul(wide_div(lo, uu), u.x); \
+        Scalar b = scalar_mul(wide_div(hi, uu), u.x); \
+        return u.x < 0 ? (Bounds) { .min = b, .max = a } : (Bounds) { .min = a, .max = b }; \
+    }
+
+/* Axis of edge a[i] -> a[j], as vec_rotate(M_PI / 2, a[i] - a[j]) */
+static inline Vector2 sat_axis(Vector2 ai, Vector2 aj, Scalar c, Scalar s)
+{
+    Vector2 d = { ai.x - aj.x, ai.y - aj.y };
+    return (Vector2) { scalar_mul(d.x, c) - scalar_mul(d.y, s),
+                       scalar_mul(d.x, s) + scalar_mul(d.y, c) };
+}
+
+static inline bool bounds_overlap(Bounds b1, Bounds b2)
+{
+    return (b1.max >= b2.min && b1.min <= b2.max) ||
+           (b2.max >= b1.min && b2.min <= b1.max);
+}
+
+/* Index of the first edge of a that separates p1 and p2, or NA */
+#define SAT_AXES(NA, N1, N2) \
+    static inline usize sat_axes_##NA##_##N1##_##N2( \
+        const Vector2 *a, const Vector2 *p1, const Vector2 *p2, Scalar c, Scalar s) \
+    { \
+        for (usize i = 0; i < NA; i++) { \
+            Vector2 u = sat_axis(a[i], a[i + 1 < NA ? i + 1 : 0], c, s); \
+            if (!bounds_overlap(sat_bounds_##N1(p1, u), sat_bounds_##N2(p2, u))) { \
+                return i; \
+            } \
+        } \
+        return NA; \
+    }
+
+#define SAT_KERNEL(N1, N2) \
+    static i32 separating_axis_##N1##_##N2(const Vector2 *p1, const Vector2 *p2) \
+    { \
+        Rotation r = trig_rotation_uncached(M_PI / 2.0); \
+        usize i = sat_axes_##N1##_##N1##_##N2(p1, p1, p2, r.c, r.s); \
+        if (i < N1) { \
+            return i; \
+        } \
+        usize j = sat_axes_##N2##_##N1##_##N2(p2, p1, p2, r.c, r.s); \
+        return j < N2 ? (i32) (N1 + j) : SAT_OVERLAP; \
+    } \
+    static bool axis_separates_##N1##_##N2(const Vector2 *p1, const Vector2 *p2, usize axis) \
+    { \
+        Rotation r = trig_rotation_uncached(M_PI / 2.0); \
+        const Vector2 *a = axis < N1 ? p1 : p2; \
+        usize na = axis < N1 ? N1 : N2; \
+        usize i = axis < N1 ? axis : axis - N1; \
+        Vector2 u = sat_axis(a[i], a[i + 1 < na ? i + 1 : 0], r.c, r.s); \
+        return !bounds_overlap(sat_bounds_##N1(p1, u), sat_bounds_##N2(p2, u)); \
+    }
+
+SAT_BOUNDS(4)
+SAT_BOUNDS(10)
+SAT_AXES(4, 4, 4)
+SAT_AXES(4, 4, 10)
+SAT_AXES(10, 4, 10)
+SAT_AXES(10, 10, 4)
+SAT_AXES(4, 10, 4)
+SAT_AXES(10, 10, 10)
+SAT_KERNEL(4, 4)
+SAT_KERNEL(4, 10)
+SAT_KERNEL(10, 4)
+SAT_KERNEL(10, 10)
+
+static i32 separating_axis_generic(Polygon *poly1, Polygon *poly2)
+{
+    usize i = find_collision_shape(poly1, poly1, poly2);
+    if (i < poly1->n) {
+        return i;
+    }
+    usize j = find_collision_shape(poly2, poly1, poly2);
+    return j < poly2->n ? (i32) (poly1->n + j) : SAT_OVERLAP;
+}
+
+i32 find_separating_axis(Polygon *poly1, Polygon *poly2)
+{
+    if (poly1->n == 10 && poly2->n == 10) {
+        return separating_axis_10_10(poly1->points, poly2->points);
+    } else if (poly1->n == 4 && poly2->n == 4) {
+        return separating_axis_4_4(poly1->points, poly2->points);
+    } else if (poly1->n == 4 && poly2->n == 10) {
+        return separating_axis_4_10(poly1->points, poly2->points);
+    } else if (poly1->n == 10 && poly2->n == 4) {
+        return separating_axis_10_4(poly1->points, poly2->points);
+    }
+    return separating_axis_generic(poly1, poly2);
 }
 
 bool find_collision(Polygon *poly1, Polygon *poly2)
 {
-    return (find_collision_shape(poly1, poly1, poly2) &&
-            find_collision_shape(poly2, poly1, poly2));
+    return find_separating_axis(poly1, poly2) == SAT_OVERLAP;
+}
+
+bool find_collision_generic(Polygon *poly1, Polygon *poly2)
+{
+    return separating_axis_generic(poly1, poly2) == SAT_OVERLAP;
+}
+
+bool narrow_collision(NarrowPhase phase, Polygon *poly1, Polygon *poly2)
+{
+    if (phase == NARROW_GJK) {
+        return find_collision_gjk(poly1, poly2);
+    }
+    return find_collision(poly1, poly2);
+}
+
+bool sat_axis_separates(Polygon *poly1, Polygon *poly2, usize axis)
+{
+    if (axis >= poly1->n + poly2->n) {
+        return false;
+    }
+    if (poly1->n == 10 && poly2->n == 10) {
+        return axis_separates_10_10(poly1->points, poly2->points, axis);
+    } else if (poly1->n == 4 && poly2->n == 4) {
+        return axis_separates_4_4(poly1->points, poly2->points, axis);
+    } else if (poly1->n == 4 && poly2->n == 10) {
+        return axis_separates_4_10(poly1->points, poly2->points, axis);
+    } else if (poly1->n == 10 && poly2->n == 4) {
+        return axis_separates_10_4(poly1->points, poly2->points, axis);
+    }
+    Polygon *edges = axis < poly1->n ? poly1 : poly2;
+    usize i = axis < poly1->n ? axis : axis - poly1->n;
+    Vector2 u = vec_rotate(M_PI / 2.0, vec_sub(edges->points[i], edges->points[(i+1) % edges->n]));
+    return !axes_overlap(poly1, poly2, u);
+}
+
+bool find_collision_warm(Polygon *poly1, Polygon *poly2, SatHint *hint, SatStats *stats)
+{
+    stats->tests += 1;
+    // Axis 0 is where a cold test starts anyway
+    if (hint->axis > 0) {
+        stats->warm += 1;
+        stats->axes += 1;
+        if (sat_axis_separates(poly1, poly2, hint->axis)) {
+            // A cold test would have stopped there too, the last time
+            stats->hits += 1;
+            stats->saved += hint->axis;
+            return false;
+        }
+    } else if (hint->axis == SAT_OVERLAP) {
+        stats->overlapping += 1;
+    }
+    i32 axis = find_separating_axis(poly1, poly2);
+    stats->axes += axis == SAT_OVERLAP ? poly1->n + poly2->n : (usize) axis + 1;
+    hint->axis = axis;
+    return axis == SAT_OVERLAP;
 }
@@ -0,0 +1,258 @@
+#include "gjk.h"
+
+typedef struct {
+    f64 x;
+    f64 y;
+} Point;
+
+static inline Point pt_sub(Point a, Point b)
+{
+    return (Point) { a.x - b.x, a.y - b.y };
+}
+
+static inline Point pt_neg(Point a)
+{
+    return (Point) { -a.x, -a.y };
+}
+
+static inline f64 pt_dot(Point a, Point b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+static inline f64 pt_cross(Point a, Point b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+static inline Point pt_from(Vector2 v)
+{
+    return (Point) { scalar_to_f64(v.x), scalar_to_f64(v.y) };
+}
+
+/* Perpendicular of v on the side of w */
+static inline Point pt_perp_towards(Point v, Point w)
+{
+    f64 side = pt_cross(v, w);
+    return side >= 0.0 ? (Point) { -v.y, v.x } : (Point) { v.y, -v.x };
+}
+
+ConvexShape shape_polygon(const Polygon *poly)
+{
+    return (ConvexShape) { .points = poly->points, .n = poly->n, .radius = 0.0 };
+}
+
+ConvexShape shape_circle(const Vector2 *center, f64 radius)
+{
+    return (ConvexShape) { .points = center, .n = 1, .radius = radius };
+}
+
+/* Farthest point of the shape along d */
+static Point support(const ConvexShape *shape, Point d)
+{
+    Point best = pt_from(shape->points[0]);
+    f64 best_dot = pt_dot(best, d);
+    for (usize i = 1; i < shape->n; i++) {
+        Point p = pt_from(shape->points[i]);
+        f64 dot = pt_dot(p, d);
+        if (dot > best_dot) {
+            best = p;
+            best_dot = dot;
+        }
+    }
+    if (shape->radius > 0.0) {
+        f64 len = sqrt(d.x * d.x + d.y * d.y);
+        if (len > 0.0) {
+            best.x += shape->radius * d.x / len;
+            best.y += shape->radius * d.y / len;
+        }
+    }
+    return best;
+}
+
+/* Farthest point of the Minkowski difference a - b along d */
+static inline Point support_diff(const ConvexShape *a, const ConvexShape *b, Point d)
+{
+    return pt_sub(support(a, d), support(b, pt_neg(d)));
+}
+
+/*
+ * Reduce the simplex to the feature nearest the origin, newest point
+ * last, and point d from it towards the origin. True once the origin is
+ * inside the simplex or on it.
+ */
+static bool do_simplex(Point *simplex, usize *count, Point *d)
+{
+    Point a = simplex[*count - 1];
+    Point ao = pt_neg(a);
+    if (*count == 2) {
+        Point ab = pt_sub(simplex[0], a);
+        if (pt_dot(ab, ao) <= 0.0) {
+            simplex[0] = a;
+            *count = 1;
+            *d = ao;
+            return false;
+        }
+        if (pt_cross(ab, ao) == 0.0) {
+            return true;
+        }
+        *d = pt_perp_towards(ab, ao);
+        return false;
+    }
+
+    Point b = simplex[1];
+    Point c = simplex[0];
+    Point ab = pt_sub(b, a);
+    Point ac = pt_sub(c, a);
+    Point ab_out = pt_perp_towards(ab, pt_neg(ac));
+    if (pt_dot(ab_out, ao) > 0.0) {
+        simplex[0] = b;
+        simplex[1] = a;
+        *count = 2;
+        *d = ab_out;
+        return false;
+    }
+    Point ac_out = pt_perp_towards(ac, pt_neg(ab));
+    if (pt_dot(ac_out, ao) > 0.0) {
+        simplex[1] = a;
+        *count = 2;
+        *d = ac_out;
+        return false;
+    }
+    return true;
+}
+
+/* GJK, leaving the simplex it ended on */
+static bool gjk(const ConvexShape *a, const ConvexShape *b, Point simplex[3], usize *count)
+{
+    Point d = pt_sub(pt_from(b->points[0]), pt_from(a->points[0]));
+    if (d.x == 0.0 && d.y == 0.0) {
+        d.x = 1.0;
+    }
+    simplex[0] = support_diff(a, b, d);
+    *count = 1;
+    d = pt_neg(simplex[0]);
+    for (usize it = 0; it < GJK_MAX_ITERATIONS; it++) {
+        if (d.x == 0.0 && d.y == 0.0) {
+            return true;
+        }
+        Point p = support_diff(a, b, d);
+        if (pt_dot(p, d) < 0.0) {
+            return false;
+        }
+        simplex[(*count)++] = p;
+        if (do_simplex(simplex, count, &d)) {
+            return true;
+        }
+    }
+    // Only pairs that touch to within rounding fail to settle
+    return false;
+}
+
+bool gjk_intersect(const ConvexShape *a, const ConvexShape *b)
+{
+    Point simplex[3];
+    usize count;
+    return gjk(a, b, simplex, &count);
+}
+
+/* Outward normal and distance from the origin of edge p -> q, CCW */
+static inline void epa_edge(Point p, Point q, Point *normal, f64 *dist)
+{
+    Point e = pt_sub(q, p);
+    f64 len = sqrt(e.x * e.x + e.y * e.y);
+    if (len == 0.0) {
+        *normal = (Point) { 1.0, 0.0 };
+        *dist = INFINITY;
+        return;
+    }
+    *normal = (Point) { e.y / len, -e.x / len };
+    *dist = pt_dot(*normal, p);
+}
+
+/*
+ * EPA: the simplex contains the origin, so push out the edge of the
+ * polytope nearest the origin with the support point along its normal
+ * until that gets no farther. The nearest edge is then on the boundary
+ * of a - b, and its distance and normal are the penetration. Each edge's
+ * normal and distance are kept, so a step only works out the two new ones.
+ */
+bool gjk_penetration(const ConvexShape *a, const ConvexShape *b, Penetration *pen)
+{
+    Point poly[EPA_MAX_VERTICES];
+    Point normals[EPA_MAX_VERTICES];
+    f64 dists[EPA_MAX_VERTICES];
+    usize count;
+    if (!gjk(a, b, poly, &count)) {
+        return false;
+    }
+    *pen = (Penetration) { .nx = 1.0, .ny = 0.0, .depth = 0.0 };
+    if (count == 1) {
+        // The origin is a support point, so on the boundary: touching
+        return true;
+    }
+    if (count == 2) {
+        // The origin is on a segment between two support points, which
+        // can still cross the inside of a - b. Grow a triangle on the
+        // side that has depth; with none on either side they only touch.
+        Point e = pt_sub(poly[1], poly[0]);
+        f64 len = sqrt(e.x * e.x + e.y * e.y);
+        Point n = { -e.y / len, e.x / len };
+        Point p = support_diff(a, b, n);
+        if (pt_dot(p, n) <= EPA_TOLERANCE) {
+            n = pt_neg(n);
+            p = support_diff(a, b, n);
+        }
+        if (pt_dot(p, n) <= EPA_TOLERANCE) {
+            pen->nx = n.x;
+            pen->ny = n.y;
+            return true;
+        }
+        poly[count++] = p;
+    }
+    if (pt_cross(pt_sub(poly[1], poly[0]), pt_sub(poly[2], poly[0])) < 0.0) {
+        Point t = poly[1];
+        poly[1] = poly[2];
+        poly[2] = t;
+    }
+    for (usize i = 0; i < count; i++) {
+        epa_edge(poly[i], poly[(i + 1) % count], &normals[i], &dists[i]);
+    }
+
+    for (;;) {
+        usize nearest = 0;
+        for (usize i = 1; i < count; i++) {
+            if (dists[i] < dists[nearest]) {
+                nearest = i;
+            }
+        }
+        Point normal = normals[nearest];
+        f64 nearest_dist = dists[nearest];
+        Point p = support_diff(a, b, normal);
+        f64 dist = pt_dot(p, normal);
+        if (dist - nearest_dist <= EPA_TOLERANCE * fmax(1.0, nearest_dist) ||
+            count == EPA_MAX_VERTICES) {
+            // Moving b by depth along n takes a - b off the origin
+            pen->nx = normal.x;
+            pen->ny = normal.y;
+            pen->depth = fmax(nearest_dist, 0.0);
+            return true;
+        }
+        for (usize i = count; i > nearest + 1; i--) {
+            poly[i] = poly[i - 1];
+            normals[i] = normals[i - 1];
+            dists[i] = dists[i - 1];
+        }
+        poly[nearest + 1] = p;
+        count += 1;
+        epa_edge(poly[nearest], p, &normals[nearest], &dists[nearest]);
+        epa_edge(p, poly[(nearest + 2) % count], &normals[nearest + 1], &dists[nearest + 1]);
+    }
+}
+
+bool find_collision_gjk(Polygon *poly1, Polygon *poly2)
+{
+    ConvexShape a = shape_polygon(poly1);
+    ConvexShape b = shape_polygon(poly2);
+    return gjk_intersect(&a, &b);
+}
@@ -0,0 +1,66 @@
+#include "histogram.h"
+
+const usize HISTOGRAM_BAR_WIDTH = 50;
+
+void histogram_init(Histogram *hist, f64 bucket_width)
+{
+    *hist = (Histogram) { .bucket_width = bucket_width };
+}
+
+void histogram_add(Histogram *hist, f64 x)
+{
+    usize bucket = x > 0.0 ? (usize) (x / hist->bucket_width) : 0;
+    if (bucket >= HISTOGRAM_BUCKETS) {
+        bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    hist->buckets[bucket] += 1;
+    hist->count += 1;
+    hist->sum += x;
+    if (x > hist->max) {
+        hist->max = x;
+    }
+}
+
+f64 histogram_percentile(const Histogram *hist, f64 p)
+{
+    u64 rank = (u64) ceil(p * hist->count);
+    u64 seen = 0;
+    for (usize i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank && seen > 0) {
+            return i == HISTOGRAM_BUCKETS - 1 ? hist->max : (i + 1) * hist->bucket_width;
+        }
+    }
+    return 0.0;
+}
+
+void histogram_print(const Histogram *hist, const char *name, f64 scale, const char *unit)
+{
+    if (hist->count == 0) {
+        printf("%s: no samples\n", name);
+        return;
+    }
+    printf("%s: %lu samples, mean %.2f %s, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+            name, hist->count, scale * hist->sum / hist->count, unit,
+            scale * histogram_percentile(hist, 0.5),
+            scale * histogram_percentile(hist, 0.9),
+            scale * histogram_percentile(hist, 0.99),
+            scale * hist->max);
+
+    u64 most = 0;
+    for (usize i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (hist->buckets[i] > most) most = hist->buckets[i];
+    }
+    for (usize i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+        usize bar = (hist->buckets[i] * HISTOGRAM_BAR_WIDTH + most - 1) / most;
+        printf("  %7.2f %s%s %8lu ", scale * i * hist->bucket_width, unit,
+                i == HISTOGRAM_BUCKETS - 1 ? "+" : " ", hist->buckets[i]);
+        for (usize j = 0; j < bar; j++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
@@ -0,0 +1,207 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "jobs.h"
+
+typedef struct {
+    usize begin;
+    usize end;
+} Job;
+
+/*
+ * The owner takes from bottom and thieves from top. Chunks are only pushed
+ * before a loop starts, so a short spinlock per deque is all the
+ * synchronisation needed and an empty deque stays empty.
+ */
+typedef struct {
+    _Alignas(64) atomic_flag lock;
+    usize top;
+    usize bottom;
+    Job jobs[JOBS_QUEUE];
+} JobDeque;
+
+static JobDeque deques[JOBS_MAX_THREADS];
+static JobFn loop_fn;
+static void *loop_aux;
+static atomic_uint_fast64_t steals;
+static JobStats stats;
+
+static pthread_t workers[JOBS_MAX_THREADS];
+static usize num_threads = 1;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static u64 pool_generation;
+static u64 pool_base_generation;
+static usize pool_finished;
+static bool pool_quitting;
+
+static MemoryPool deque_pool = { "job deques", sizeof(deques), JOBS_QUEUE, 0 };
+_Static_assert(sizeof(deques) <= MEMORY_BUDGET_JOBS, "job deques exceed the jobs budget");
+
+static bool take(JobDeque *deque, bool steal, Job *job)
+{
+    while (atomic_flag_test_and_set_explicit(&deque->lock, memory_order_acquire)) {
+    }
+    bool found = deque->bottom > deque->top;
+    if (found) {
+        if (steal) {
+            *job = deque->jobs[deque->top];
+            deque->top += 1;
+        } else {
+            deque->bottom -= 1;
+            *job = deque->jobs[deque->bottom];
+        }
+    }
+    atomic_flag_clear_explicit(&deque->lock, memory_order_release);
+    return found;
+}
+
+static void run_jobs(usize thread)
+{
+    Job job;
+    for (;;) {
+        if (take(&deques[thread], false, &job)) {
+            loop_fn(loop_aux, job.begin, job.end, thread);
+            continue;
+        }
+        bool stolen = false;
+        for (usize k = 1; k < num_threads && !stolen; k++) {
+            stolen = take(&deques[(thread + k) % num_threads], true, &job);
+        }
+        if (!stolen) {
+            return;
+        }
+        atomic_fetch_add_explicit(&steals, 1, memory_order_relaxed);
+        loop_fn(loop_aux, job.begin, job.end, thread);
+    }
+}
+
+static void *jobs_worker(void *aux)
+{
+    usize thread = (usize) aux;
+    u64 seen = pool_base_generation;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_generation == seen && !pool_quitting) {
+            pthread_cond_wait(&pool_start, &pool_lock);
+        }
+        if (pool_quitting) {
+            break;
+        }
+        seen = pool_generation;
+        pthread_mutex_unlock(&pool_lock);
+
+        run_jobs(thread);
+
+        pthread_mutex_lock(&pool_lock);
+        pool_finished += 1;
+        pthread_cond_signal(&pool_done);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+void jobs_init(usize threads)
+{
+    if (threads < 1) threads = 1;
+    if (threads > JOBS_MAX_THREADS) threads = JOBS_MAX_THREADS;
+    num_threads = threads;
+    pool_quitting = false;
+    pool_base_generation = pool_generation;
+    for (usize i = 0; i < JOBS_MAX_THREADS; i++) {
+        atomic_flag_clear(&deques[i].lock);
+        deques[i].top = 0;
+        deques[i].bottom = 0;
+    }
+    for (usize i = 1; i < num_threads; i++) {
+        pthread_create(&workers[i], NULL, jobs_worker, (void *) i);
+    }
+    memset(&stats, 0, sizeof(stats));
+    atomic_store(&steals, 0);
+}
+
+void jobs_quit(void)
+{
+    pthread_mutex_lock(&pool_lock);
+    pool_quitting = true;
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_lock);
+    for (usize i = 1; i < num_threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    num_threads = 1;
+}
+
+usize jobs_threads(void)
+{
+    return num_threads;
+}
+
+void jobs_parallel_for(usize n, usize grain, JobFn fn, void *aux)
+{
+    if (n == 0) {
+        return;
+    }
+    if (grain < 1) grain = 1;
+    stats.loops += 1;
+    if (num_threads == 1 || n <= grain) {
+        stats.chunks += 1;
+        fn(aux, 0, n, 0);
+        return;
+    }
+
+    // Coarsen the chunks until every thread's share fits in its deque
+    usize chunks = (n + grain - 1) / grain;
+    if (chunks > JOBS_QUEUE * num_threads) {
+        chunks = JOBS_QUEUE * num_threads;
+        grain = (n + chunks - 1) / chunks;
+        chunks = (n + grain - 1) / grain;
+    }
+    for (usize t = 0; t < num_threads; t++) {
+        JobDeque *deque = &deques[t];
+        usize first = t * chunks / num_threads;
+        usize last = (t + 1) * chunks / num_threads;
+        memory_use(&deque_pool, last - first);
+        deque->top = 0;
+        deque->bottom = 0;
+        // Pushed last to first so the owner walks its run in order
+        for (usize c = last; c > first; c--) {
+            usize begin = (c - 1) * grain;
+            usize end = begin + grain < n ? begin + grain : n;
+            deque->jobs[deque->bottom] = (Job) { .begin = begin, .end = end };
+            deque->bottom += 1;
+        }
+    }
+    stats.chunks += chunks;
+    loop_fn = fn;
+    loop_aux = aux;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_generation += 1;
+    pool_finished = 0;
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_lock);
+
+    run_jobs(0);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_finished < num_threads - 1) {
+        pthread_cond_wait(&pool_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+JobStats jobs_stats(void)
+{
+    JobStats s = stats;
+    s.steals = atomic_load(&steals);
+    return s;
+}
+
+usize jobs_memory(const MemoryPool **pools)
+{
+    *pools = &deque_pool;
+    return 1;
+}
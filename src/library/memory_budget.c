@@ -0,0 +1,18 @@
+#include "memory_budget.h"
+
+usize memory_print(const char *subsystem, const MemoryPool *pools, usize n, usize budget)
+{
+    usize total = 0;
+    for (usize i = 0; i < n; i++) {
+        total += pools[i].bytes;
+    }
+    printf("%-8s %10lu bytes, %5.1f%% of %lu budget\n",
+            subsystem, total, 100.0 * total / budget, budget);
+    for (usize i = 0; i < n; i++) {
+        const MemoryPool *pool = &pools[i];
+        printf("  %-16s %10lu bytes %7lu slots, high water %7lu (%5.1f%%)\n",
+                pool->name, pool->bytes, pool->capacity, pool->high_water,
+                pool->capacity ? 100.0 * pool->high_water / pool->capacity : 0.0);
+    }
+    return total;
+}
@@ -0,0 +1,156 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "perf_counters.h"
+
+const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    [COUNTER_CYCLES] = "cycles",
+    [COUNTER_INSTRUCTIONS] = "instructions",
+    [COUNTER_L1D_MISSES] = "L1D misses",
+    [COUNTER_LLC_MISSES] = "LLC misses",
+    [COUNTER_BRANCH_MISSES] = "branch misses",
+};
+
+static int fds[NUM_COUNTERS];
+static bool opened[NUM_COUNTERS];
+static usize slots[NUM_COUNTERS]; // Place of each counter in a group read
+static usize num_open;
+static int leader = -1;
+static char error[128];
+
+#ifdef __linux__
+
+typedef struct {
+    u32 type;
+    u64 config;
+} CounterEvent;
+
+static const CounterEvent EVENTS[NUM_COUNTERS] = {
+    [COUNTER_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [COUNTER_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [COUNTER_L1D_MISSES] = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+        PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    [COUNTER_LLC_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [COUNTER_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+usize counters_open(void)
+{
+    if (leader >= 0) {
+        return num_open;
+    }
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = EVENTS[c].type;
+        attr.config = EVENTS[c].config;
+        // The group starts once all of it is open
+        attr.disabled = leader < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (fd < 0) {
+            if (!error[0]) {
+                snprintf(error, sizeof(error), "%s: %s", COUNTER_NAMES[c], strerror(errno));
+            }
+            continue;
+        }
+        if (leader < 0) {
+            leader = fd;
+        }
+        fds[c] = fd;
+        opened[c] = true;
+        slots[c] = num_open++;
+    }
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    return num_open;
+}
+
+void counters_read(CounterValues *values)
+{
+    memset(values, 0, sizeof(*values));
+    if (leader < 0) {
+        return;
+    }
+    // nr, time enabled, time running, then a value per counter
+    u64 data[3 + NUM_COUNTERS];
+    ssize_t bytes = read(leader, data, sizeof(data));
+    if (bytes < (ssize_t) ((3 + num_open) * sizeof(u64))) {
+        return;
+    }
+    values->enabled = data[1];
+    values->running = data[2];
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        if (opened[c]) {
+            values->counts[c] = data[3 + slots[c]];
+        }
+    }
+}
+
+#else
+
+usize counters_open(void)
+{
+    snprintf(error, sizeof(error), "perf_event_open is Linux only");
+    return 0;
+}
+
+void counters_read(CounterValues *values)
+{
+    memset(values, 0, sizeof(*values));
+}
+
+#endif
+
+void counters_scale(const CounterValues *from, const CounterValues *to, u64 *counts)
+{
+    u64 enabled = to->enabled - from->enabled;
+    u64 running = to->running - from->running;
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        u64 delta = to->counts[c] - from->counts[c];
+        if (running > 0 && running < enabled) {
+            delta = (u64) ((f64) delta * enabled / running);
+        }
+        counts[c] = delta;
+    }
+}
+
+bool counters_active(void)
+{
+    return leader >= 0;
+}
+
+bool counter_available(Counter counter)
+{
+    return opened[counter];
+}
+
+const char *counters_error(void)
+{
+    return error[0] ? error : NULL;
+}
+
+void counters_close(void)
+{
+    for (usize c = 0; c < NUM_COUNTERS; c++) {
+        if (opened[c]) {
+            close(fds[c]);
+            opened[c] = false;
+        }
+    }
+    num_open = 0;
+    leader = -1;
+}
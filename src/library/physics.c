@@ -0,0 +1,320 @@
+#include <string.h>
+
+#include "physics.h"
+#include "gjk.h"
+#include "jobs.h"
+
+typedef struct {
+    u16 a;
+    u16 b;
+} BodyPair;
+
+typedef struct {
+    u32 key;
+    u16 a;
+    u16 b;
+    Penetration pen;
+} Staged;
+
+// Broad phase
+static f64 min_x[MAX_ENTITIES];
+static f64 max_x[MAX_ENTITIES];
+static f64 min_y[MAX_ENTITIES];
+static f64 max_y[MAX_ENTITIES];
+static u16 order[MAX_ENTITIES];
+static BodyPair pairs[PHYSICS_MAX_PAIRS];
+static Penetration pair_pens[PHYSICS_MAX_PAIRS];
+static bool pair_hits[PHYSICS_MAX_PAIRS];
+
+// Contacts in key order, then as arrays batch by batch
+static Staged staged[MAX_CONTACTS];
+static usize staged_batch[MAX_CONTACTS];
+static usize staged_slot[MAX_CONTACTS];
+static u32 body_batches[MAX_ENTITIES];
+static usize batch_start[PHYSICS_MAX_BATCHES + 1];
+static u16 contact_a[MAX_CONTACTS];
+static u16 contact_b[MAX_CONTACTS];
+static f64 contact_nx[MAX_CONTACTS];
+static f64 contact_ny[MAX_CONTACTS];
+static f64 contact_mass[MAX_CONTACTS];
+static f64 contact_target[MAX_CONTACTS];
+static f64 contact_impulse[MAX_CONTACTS];
+static f64 contact_vn[MAX_CONTACTS];
+static f64 contact_delta[MAX_CONTACTS];
+
+#define PAIR_BYTES (sizeof(min_x) + sizeof(max_x) + sizeof(min_y) + sizeof(max_y) + \
+    sizeof(order) + sizeof(pairs) + sizeof(pair_pens) + sizeof(pair_hits))
+#define CONTACT_BYTES (sizeof(staged) + sizeof(staged_batch) + sizeof(staged_slot) + \
+    sizeof(body_batches) + sizeof(contact_a) + sizeof(contact_b) + sizeof(contact_nx) + \
+    sizeof(contact_ny) + sizeof(contact_mass) + sizeof(contact_target) + \
+    sizeof(contact_impulse) + sizeof(contact_vn) + sizeof(contact_delta))
+
+enum { PAIR_POOL, CONTACT_POOL, NUM_PHYSICS_POOLS };
+static MemoryPool physics_pools[NUM_PHYSICS_POOLS] = {
+    [PAIR_POOL] = { "physics pairs", PAIR_BYTES, PHYSICS_MAX_PAIRS, 0 },
+    [CONTACT_POOL] = { "physics contacts", CONTACT_BYTES, MAX_CONTACTS, 0 },
+};
+_Static_assert(PAIR_BYTES + CONTACT_BYTES <= MEMORY_BUDGET_PHYSICS,
+        "physics scratch exceeds the physics budget");
+_Static_assert(MAX_ENTITIES <= UINT16_MAX, "Body indices fit a u16");
+
+static int compare_min_x(const void *a, const void *b)
+{
+    u16 i = *(const u16 *) a;
+    u16 j = *(const u16 *) b;
+    if (min_x[i] != min_x[j]) {
+        return min_x[i] < min_x[j] ? -1 : 1;
+    }
+    return (i > j) - (i < j);
+}
+
+static int compare_staged(const void *a, const void *b)
+{
+    u32 x = ((const Staged *) a)->key;
+    u32 y = ((const Staged *) b)->key;
+    return (x > y) - (x < y);
+}
+
+/* Sort and sweep: pairs whose extents overlap, in sweep order */
+static usize find_pairs(const Body *bodies, usize n, PhysicsStats *stats)
+{
+    for (usize i = 0; i < n; i++) {
+        Polygon poly = bodies[i].poly;
+        Vector2 lo = poly_min(&poly);
+        Vector2 hi = poly_max(&poly);
+        min_x[i] = scalar_to_f64(lo.x);
+        min_y[i] = scalar_to_f64(lo.y);
+        max_x[i] = scalar_to_f64(hi.x);
+        max_y[i] = scalar_to_f64(hi.y);
+        order[i] = i;
+    }
+    qsort(order, n, sizeof(u16), compare_min_x);
+
+    usize count = 0;
+    for (usize i = 0; i < n; i++) {
+        u16 a = order[i];
+        for (usize j = i + 1; j < n && min_x[order[j]] <= max_x[a]; j++) {
+            u16 b = order[j];
+            if (min_y[b] > max_y[a] || max_y[b] < min_y[a] ||
+                (bodies[a].asleep && bodies[b].asleep)) {
+                continue;
+            }
+            if (count == PHYSICS_MAX_PAIRS) {
+                stats->dropped += 1;
+                continue;
+            }
+            pairs[count++] = (BodyPair) { .a = a, .b = b };
+        }
+    }
+    memory_use(&physics_pools[PAIR_POOL], count);
+    return count;
+}
+
+static void narrow_job(void *aux, usize begin, usize end, usize thread)
+{
+    const Body *bodies = aux;
+    (void) thread;
+    for (usize p = begin; p < end; p++) {
+        ConvexShape a = shape_polygon(&bodies[pairs[p].a].poly);
+        ConvexShape b = shape_polygon(&bodies[pairs[p].b].poly);
+        pair_hits[p] = gjk_penetration(&a, &b, &pair_pens[p]);
+    }
+}
+
+/* Hits as contacts in key order, the lower id first, normal from it */
+static usize stage_contacts(const Body *bodies, usize num_pairs, PhysicsStats *stats)
+{
+    usize count = 0;
+    for (usize p = 0; p < num_pairs; p++) {
+        if (!pair_hits[p]) {
+            continue;
+        }
+        if (count == MAX_CONTACTS) {
+            stats->dropped += 1;
+            continue;
+        }
+        u16 a = pairs[p].a;
+        u16 b = pairs[p].b;
+        Penetration pen = pair_pens[p];
+        if (bodies[a].id > bodies[b].id) {
+            u16 t = a;
+            a = b;
+            b = t;
+            pen.nx = -pen.nx;
+            pen.ny = -pen.ny;
+        }
+        staged[count++] = (Staged) {
+            .key = (u32) bodies[a].id << 16 | bodies[b].id,
+            .a = a,
+            .b = b,
+            .pen = pen,
+        };
+    }
+    qsort(staged, count, sizeof(Staged), compare_staged);
+    memory_use(&physics_pools[CONTACT_POOL], count);
+    return count;
+}
+
+/* Greedy coloring into batches, then the arrays in batch order */
+static void batch_contacts(const Body *bodies, usize n, usize count, PhysicsStats *stats)
+{
+    memset(body_batches, 0, n * sizeof(u32));
+    usize sizes[PHYSICS_MAX_BATCHES] = {0};
+    for (usize c = 0; c < count; c++) {
+        u32 used = body_batches[staged[c].a] | body_batches[staged[c].b];
+        // The last batch takes whatever is left and is solved serially
+        usize batch = PHYSICS_MAX_BATCHES - 1;
+        if (~used & ((1u << (PHYSICS_MAX_BATCHES - 1)) - 1)) {
+            batch = __builtin_ctz(~used);
+            body_batches[staged[c].a] |= 1u << batch;
+            body_batches[staged[c].b] |= 1u << batch;
+        }
+        staged_batch[c] = batch;
+        sizes[batch] += 1;
+    }
+    batch_start[0] = 0;
+    for (usize k = 0; k < PHYSICS_MAX_BATCHES; k++) {
+        batch_start[k + 1] = batch_start[k] + sizes[k];
+        stats->batches += k < PHYSICS_MAX_BATCHES - 1 && sizes[k] > 0;
+    }
+    stats->serial += sizes[PHYSICS_MAX_BATCHES - 1];
+
+    usize next[PHYSICS_MAX_BATCHES];
+    memcpy(next, batch_start, sizeof(next));
+    for (usize c = 0; c < count; c++) {
+        usize slot = next[staged_batch[c]]++;
+        const Staged *s = &staged[c];
+        const Body *a = &bodies[s->a];
+        const Body *b = &bodies[s->b];
+        f64 inv = a->inv_mass + b->inv_mass;
+        staged_slot[c] = slot;
+        contact_a[slot] = s->a;
+        contact_b[slot] = s->b;
+        contact_nx[slot] = s->pen.nx;
+        contact_ny[slot] = s->pen.ny;
+        contact_mass[slot] = inv > 0.0 ? 1.0 / inv : 0.0;
+        f64 vn = (b->vx - a->vx) * s->pen.nx + (b->vy - a->vy) * s->pen.ny;
+        contact_target[slot] = vn < -PHYSICS_BOUNCE_SPEED ? -PHYSICS_RESTITUTION * vn : 0.0;
+        contact_impulse[slot] = 0.0;
+    }
+}
+
+static inline void apply_impulse(Body *bodies, usize c, f64 impulse)
+{
+    Body *a = &bodies[contact_a[c]];
+    Body *b = &bodies[contact_b[c]];
+    a->vx -= impulse * a->inv_mass * contact_nx[c];
+    a->vy -= impulse * a->inv_mass * contact_ny[c];
+    b->vx += impulse * b->inv_mass * contact_nx[c];
+    b->vy += impulse * b->inv_mass * contact_ny[c];
+}
+
+/* The impulses of contacts [begin, end), none sharing a body */
+static void solve_batch(Body *bodies, usize begin, usize end)
+{
+    for (usize c = begin; c < end; c++) {
+        const Body *a = &bodies[contact_a[c]];
+        const Body *b = &bodies[contact_b[c]];
+        contact_vn[c] = (b->vx - a->vx) * contact_nx[c] + (b->vy - a->vy) * contact_ny[c];
+    }
+    for (usize c = begin; c < end; c++) {
+        f64 lambda = contact_mass[c] * (contact_target[c] - contact_vn[c]);
+        f64 impulse = fmax(contact_impulse[c] + lambda, 0.0);
+        contact_delta[c] = impulse - contact_impulse[c];
+        contact_impulse[c] = impulse;
+    }
+    for (usize c = begin; c < end; c++) {
+        apply_impulse(bodies, c, contact_delta[c]);
+    }
+}
+
+static void solve_serial(Body *bodies, usize begin, usize end)
+{
+    for (usize c = begin; c < end; c++) {
+        solve_batch(bodies, c, c + 1);
+    }
+}
+
+static f32 cached_impulse(const ContactCache *cache, u32 key)
+{
+    usize lo = 0;
+    usize hi = cache->length;
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if (cache->contacts[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < cache->length && cache->contacts[lo].key == key) {
+        return cache->contacts[lo].impulse;
+    }
+    return 0.0f;
+}
+
+void physics_step(Body *bodies, usize n, ContactCache *cache, PhysicsStats *stats)
+{
+    stats->steps += 1;
+    for (usize i = 0; i < n; i++) {
+        bodies[i].dx = 0.0;
+        bodies[i].dy = 0.0;
+    }
+    usize num_pairs = find_pairs(bodies, n, stats);
+    jobs_parallel_for(num_pairs, PHYSICS_GRAIN, narrow_job, bodies);
+    usize count = stage_contacts(bodies, num_pairs, stats);
+    stats->pairs += num_pairs;
+    stats->contacts += count;
+
+    // A contact with an awake body wakes a sleeping one
+    for (usize c = 0; c < count; c++) {
+        Body *a = &bodies[staged[c].a];
+        Body *b = &bodies[staged[c].b];
+        if (a->asleep != b->asleep) {
+            stats->woken += 1;
+            a->asleep = false;
+            b->asleep = false;
+        }
+    }
+    batch_contacts(bodies, n, count, stats);
+
+    // Warm start from the last step, whose contacts are in key order too
+    for (usize c = 0; c < count; c++) {
+        usize slot = staged_slot[c];
+        f64 impulse = cached_impulse(cache, staged[c].key);
+        stats->warm += impulse > 0.0;
+        contact_impulse[slot] = impulse;
+        apply_impulse(bodies, slot, impulse);
+    }
+
+    for (usize it = 0; it < PHYSICS_ITERATIONS; it++) {
+        for (usize k = 0; k < PHYSICS_MAX_BATCHES - 1; k++) {
+            solve_batch(bodies, batch_start[k], batch_start[k + 1]);
+        }
+        solve_serial(bodies, batch_start[PHYSICS_MAX_BATCHES - 1],
+                batch_start[PHYSICS_MAX_BATCHES]);
+    }
+
+    for (usize c = 0; c < count; c++) {
+        const Staged *s = &staged[c];
+        Body *a = &bodies[s->a];
+        Body *b = &bodies[s->b];
+        f64 push = fmax(s->pen.depth - PHYSICS_SLOP, 0.0) * PHYSICS_CORRECTION *
+                   contact_mass[staged_slot[c]];
+        a->dx -= push * a->inv_mass * s->pen.nx;
+        a->dy -= push * a->inv_mass * s->pen.ny;
+        b->dx += push * b->inv_mass * s->pen.nx;
+        b->dy += push * b->inv_mass * s->pen.ny;
+        cache->contacts[c] = (WarmContact) {
+            .key = s->key,
+            .impulse = (f32) contact_impulse[staged_slot[c]],
+        };
+    }
+    cache->length = count;
+}
+
+usize physics_memory(const MemoryPool **pools)
+{
+    *pools = physics_pools;
+    return NUM_PHYSICS_POOLS;
+}
@@ -1,22 +1,151 @@
 #include "polygon.h"
+#include "trig.h"
+
+/*
+ * Kernels for the vertex counts entities actually have, 4 for the player
+ * and 10 for everything else, with n fixed at compile time so the loops
+ * unroll and wrapping to the first vertex needs no modulo. They do the
+ * same arithmetic in the same order as the generic loops below, so the
+ * results are identical bit for bit, only faster.
+ */
+#define POLY_KERNELS(N) \
+    static void poly_translate_##N(Vector2 *p, Vector2 t) \
+    { \
+        POLY_UNROLL \
+        for (usize i = 0; i < N; i++) { \
+            p[i].x += t.x; \
+            p[i].y += t.y; \
+        } \
+    } \
+    \
+    static void poly_rotate_##N(Vector2 *p, f64 theta, Vector2 v) \
+    { \
+        Rotation r = trig_rotation(theta); \
+        POLY_UNROLL \
+        for (usize i = 0; i < N; i++) { \
+            Vector2 d = { p[i].x - v.x, p[i].y - v.y }; \
+            p[i].x = (scalar_mul(d.x, r.c) - scalar_mul(d.y, r.s)) + v.x; \
+            p[i].y = (scalar_mul(d.x, r.s) + scalar_mul(d.y, r.c)) + v.y; \
+        } \
+    } \
+    \
+    static Vector2 poly_min_##N(const Vector2 *p) \
+    { \
+        Vector2 min = { SCALAR_MAX, SCALAR_MAX }; \
+        POLY_UNROLL \
+        for (usize i = 0; i < N; i++) { \
+            if (p[i].x < min.x) min.x = p[i].x; \
+            if (p[i].y < min.y) min.y = p[i].y; \
+        } \
+        return min; \
+    } \
+    \
+    static Vector2 poly_max_##N(const Vector2 *p) \
+    { \
+        Vector2 max = { SCALAR_MIN, SCALAR_MIN }; \
+        POLY_UNROLL \
+        for (usize i = 0; i < N; i++) { \
+            if (p[i].x > max.x) max.x = p[i].x; \
+            if (p[i].y > max.y) max.y = p[i].y; \
+        } \
+        return max; \
+    } \
+    \
+    static Vector2 poly_centroid_##N(const Vector2 *p) \
+    { \
+        Vector2 o = p[0]; \
+        WideScalar cx = 0; \
+        WideScalar cy = 0; \
+        WideScalar area = 0; \
+        POLY_UNROLL \
+        for (usize i = 0; i < N; i++) { \
+            usize j = i + 1 < N ? i + 1 : 0; \
+            Vector2 v1 = { p[i].x - o.x, p[i].y - o.y }; \
+            Vector2 v2 = { p[j].x - o.x, p[j].y - o.y }; \
+            WideScalar cross = wide_mul(v1.x, v2.y) - wide_mul(v1.y, v2.x); \
+            cx += wide_mul_scalar(cross, v1.x + v2.x); \
+            cy += wide_mul_scalar(cross, v1.y + v2.y); \
+            area += cross; \
+        } \
+        return (Vector2) { o.x + wide_div(cx, 3 * area), o.y + wide_div(cy, 3 * area) }; \
+    }
+
+POLY_KERNELS(4)
+POLY_KERNELS(10)
+
+bool poly_has_kernel(usize n)
+{
+    return n == 4 || n == 10;
+}
 
 void poly_translate(Polygon *poly, Vector2 t)
+{
+    switch (poly->n) {
+        case 4: poly_translate_4(poly->points, t); break;
+        case 10: poly_translate_10(poly->points, t); break;
+        default: poly_translate_generic(poly, t); break;
+    }
+}
+
+void poly_rotate(Polygon *poly, f64 theta, Vector2 v)
+{
+    switch (poly->n) {
+        case 4: poly_rotate_4(poly->points, theta, v); break;
+        case 10: poly_rotate_10(poly->points, theta, v); break;
+        default: poly_rotate_generic(poly, theta, v); break;
+    }
+}
+
+Vector2 poly_min(Polygon *poly)
+{
+    switch (poly->n) {
+        case 4: return poly_min_4(poly->points);
+        case 10: return poly_min_10(poly->points);
+        default: return poly_min_generic(poly);
+    }
+}
+
+Vector2 poly_max(Polygon *poly)
+{
+    switch (poly->n) {
+        case 4: return poly_max_4(poly->points);
+        case 10: return poly_max_10(poly->points);
+        default: return poly_max_generic(poly);
+    }
+}
+
+Vector2 poly_centroid(Polygon *poly)
+{
+    switch (poly->n) {
+        case 4: return poly_centroid_4(poly->points);
+        case 10: return poly_centroid_10(poly->points);
+        default: return poly_centroid_generic(poly);
+    }
+}
+
+/* Any vertex count */
+
+void poly_translate_generic(Polygon *poly, Vector2 t)
 {
     for (usize i = 0; i < poly->n; i++) {
         poly->points[i] = vec_add(poly->points[i], t);
     }
 }
 
-void poly_rotate(Polygon *poly, f64 theta, Vector2 v)
+void poly_rotate_generic(Polygon *poly, f64 theta, Vector2 v)
 {
+    Rotation r = trig_rotation(theta);
     for (usize i = 0; i < poly->n; i++) {
-        poly->points[i] = vec_add(vec_rotate(theta, vec_sub(poly->points[i], v)), v);
+        Vector2 d = vec_sub(poly->points[i], v);
+        Vector2 rd = { scalar_mul(d.x, r.c) - scalar_mul(d.y, r.s),
+                       scalar_mul(d.x, r.s) + scalar_mul(d.y, r.c) };
+        poly->points[i] = vec_add(rd, v);
     }
 }
 
-Vector2 poly_min(Polygon *poly)
+Vector2 poly_min_generic(Polygon *poly)
 {
-    Vector2 min = vec(INFINITY, INFINITY);
+    Vector2 min = { SCALAR_MAX, SCALAR_MAX };
     for (usize i = 0; i < poly->n; i++) {
         if (poly->points[i].x < min.x) min.x = poly->points[i].x;
         if (poly->points[i].y < min.y) min.y = poly->points[i].y;
@@ -24,9 +153,9 @@ Vector2 poly_min(Polygon *poly)
     return min;
 }
 
-Vector2 poly_max(Polygon *poly)
+Vector2 poly_max_generic(Polygon *poly)
 {
-    Vector2 max = vec(-INFINITY, -INFINITY);
+    Vector2 max = { SCALAR_MIN, SCALAR_MIN };
     for (usize i = 0; i < poly->n; i++) {
         if (poly->points[i].x > max.x) max.x = poly->points[i].x;
         if (poly->points[i].y > max.y) max.y = poly->points[i].y;
@@ -34,28 +163,37 @@ Vector2 poly_max(Polygon *poly)
     return max;
 }
 
-f64 poly_signed_area(Polygon *poly)
+WideScalar poly_signed_area(Polygon *poly)
 {
-    f64 area = 0;
+    WideScalar area = 0;
     for (usize i = 0; i < poly->n; i++) {
         area += vec_cross(poly->points[i], poly->points[(i+1) % poly->n]);
     }
-    return 1.0 / 2.0 * area;
+    return area / 2;
 }
 
-f64 poly_area(Polygon *poly)
+WideScalar poly_area(Polygon *poly)
 {
-    return fabs(poly_signed_area(poly));
+    return wide_abs(poly_signed_area(poly));
 }
 
-Vector2 poly_centroid(Polygon *poly)
+/*
+ * Accumulate relative to the first vertex: the result is the same, but the
+ * sums stay small enough for fixed point wherever the polygon is.
+ */
+Vector2 poly_centroid_generic(Polygon *poly)
 {
-    Vector2 c = vec(0.0, 0.0);
+    Vector2 o = poly->points[0];
+    WideScalar cx = 0;
+    WideScalar cy = 0;
+    WideScalar area = 0;
     for (usize i = 0; i < poly->n; i++) {
-        Vector2 v1 = poly->points[i];
-        Vector2 v2 = poly->points[(i+1) % poly->n];
-        c = vec_add(c, vec_mul(vec_cross(v1, v2), vec_add(v1, v2)));
+        Vector2 v1 = vec_sub(poly->points[i], o);
+        Vector2 v2 = vec_sub(poly->points[(i+1) % poly->n], o);
+        WideScalar cross = vec_cross(v1, v2);
+        cx += wide_mul_scalar(cross, v1.x + v2.x);
+        cy += wide_mul_scalar(cross, v1.y + v2.y);
+        area += cross;
     }
-    return vec_mul(1.0 / (6.0 * poly_signed_area(poly)), c);
+    return vec_add(o, (Vector2) { wide_div(cx, 3 * area), wide_div(cy, 3 * area) });
 }
-
@@ -0,0 +1,44 @@
+#include "quality_governor.h"
+
+const f64 QUALITY_SMOOTHING = 0.2;
+const f64 QUALITY_OVER_BUDGET = 1.0;
+const f64 QUALITY_SPIKE = 2.0;
+const f64 QUALITY_UNDER_BUDGET = 0.6;
+const usize QUALITY_COOLDOWN_FRAMES = 10;
+const usize QUALITY_RESTORE_FRAMES = 120;
+
+void quality_governor_init(QualityGovernor *gov, f64 budget, u8 max_level)
+{
+    gov->level = 0;
+    gov->max_level = max_level;
+    gov->budget = budget;
+    gov->average = 0.0;
+    gov->cooldown = 0;
+    gov->calm = 0;
+}
+
+u8 quality_governor_update(QualityGovernor *gov, f64 frame_cost)
+{
+    gov->average += QUALITY_SMOOTHING * (frame_cost - gov->average);
+    if (gov->average < QUALITY_UNDER_BUDGET * gov->budget) {
+        gov->calm += 1;
+    } else {
+        gov->calm = 0;
+    }
+    if (gov->cooldown > 0) {
+        gov->cooldown -= 1;
+        return gov->level;
+    }
+
+    bool over = gov->average > QUALITY_OVER_BUDGET * gov->budget ||
+                frame_cost > QUALITY_SPIKE * gov->budget;
+    if (over && gov->level < gov->max_level) {
+        gov->level += 1;
+        gov->cooldown = QUALITY_COOLDOWN_FRAMES;
+        gov->calm = 0;
+    } else if (gov->calm >= QUALITY_RESTORE_FRAMES && gov->level > 0) {
+        gov->level -= 1;
+        gov->calm = 0;
+    }
+    return gov->level;
+}
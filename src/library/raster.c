@@ -0,0 +1,351 @@
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "raster.h"
+#include "jobs.h"
+
+#define SUBPIXEL_BITS 4
+#define SUBPIXEL (1 << SUBPIXEL_BITS)
+
+typedef struct {
+    i64 a[MAX_POINTS];
+    i64 b[MAX_POINTS];
+    i64 c[MAX_POINTS];
+    i64 bias[MAX_POINTS];
+    usize n;
+    i32 min_x;
+    i32 min_y;
+    i32 max_x;
+    i32 max_y;
+    Pixel color;
+    u8 alpha;
+} Prim;
+
+static Pixel framebuffer[WIDTH * HEIGHT];
+static Prim prims[RASTER_MAX_PRIMS];
+static usize num_prims;
+static u16 tile_prims[RASTER_TILES][RASTER_MAX_TILE_PRIMS];
+static usize tile_lengths[RASTER_TILES];
+static u64 tile_pixels[RASTER_TILES];
+static Pixel clear_color;
+static bool clear_pending;
+static RasterStats stats;
+
+enum { FRAMEBUFFER_POOL, PRIM_POOL, TILE_POOL, NUM_POOLS };
+static MemoryPool pools[NUM_POOLS] = {
+    [FRAMEBUFFER_POOL] = { "framebuffer", sizeof(framebuffer), WIDTH * HEIGHT, WIDTH * HEIGHT },
+    [PRIM_POOL] = { "prims", sizeof(prims), RASTER_MAX_PRIMS, 0 },
+    // Per tile, so the high water is the fullest bin
+    [TILE_POOL] = { "tile bins", sizeof(tile_prims) + sizeof(tile_lengths) + sizeof(tile_pixels),
+                    RASTER_MAX_TILE_PRIMS, 0 },
+};
+_Static_assert(sizeof(framebuffer) + sizeof(prims) + sizeof(tile_prims) <= MEMORY_BUDGET_RENDER,
+        "raster pools exceed the render budget");
+
+static Pixel pack_color(Color c, u8 *alpha)
+{
+    f64 channels[4] = { c.r, c.g, c.b, c.a };
+    u8 bytes[4];
+    for (usize i = 0; i < 4; i++) {
+        f64 v = channels[i];
+        if (v < 0.0) v = 0.0;
+        if (v > 1.0) v = 1.0;
+        bytes[i] = (u8) (255 * v);
+    }
+    *alpha = bytes[3];
+    return (Pixel) bytes[0] | (Pixel) bytes[1] << 8 |
+           (Pixel) bytes[2] << 16 | (Pixel) 0xff << 24;
+}
+
+static i64 floor_div(i64 a, i64 b)
+{
+    i64 q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) {
+        q -= 1;
+    }
+    return q;
+}
+
+static i64 ceil_div(i64 a, i64 b)
+{
+    return -floor_div(-a, b);
+}
+
+/* Round-to-nearest blend of src over dst, t / 255 computed as in the SIMD path */
+static Pixel blend_pixel(Pixel src, Pixel dst, u8 alpha)
+{
+    Pixel out = 0;
+    for (usize i = 0; i < 4; i++) {
+        u32 s = (src >> (8 * i)) & 0xff;
+        u32 d = (dst >> (8 * i)) & 0xff;
+        u32 x = s * alpha + d * (255 - alpha) + 128;
+        out |= (((x + (x >> 8)) >> 8) & 0xff) << (8 * i);
+    }
+    return out;
+}
+
+static void fill_span(Pixel *row, i32 x0, i32 x1, Pixel color, u8 alpha)
+{
+    i32 x = x0;
+    if (alpha == 255) {
+#ifdef __SSE2__
+        __m128i c = _mm_set1_epi32((i32) color);
+        for (; x + 4 <= x1; x += 4) {
+            _mm_storeu_si128((__m128i *) &row[x], c);
+        }
+#endif
+        for (; x < x1; x++) {
+            row[x] = color;
+        }
+        return;
+    }
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_mullo_epi16(
+            _mm_unpacklo_epi8(_mm_set1_epi32((i32) color), zero),
+            _mm_set1_epi16(alpha));
+    __m128i inv = _mm_set1_epi16(255 - alpha);
+    __m128i round = _mm_set1_epi16(128);
+    for (; x + 4 <= x1; x += 4) {
+        __m128i dst = _mm_loadu_si128((__m128i *) &row[x]);
+        __m128i lo = _mm_unpacklo_epi8(dst, zero);
+        __m128i hi = _mm_unpackhi_epi8(dst, zero);
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, inv), src), round);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, inv), src), round);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *) &row[x], _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; x < x1; x++) {
+        row[x] = blend_pixel(color, row[x], alpha);
+    }
+}
+
+/* Rasterize every primitive binned into tile t, in submission order */
+static void raster_tile(usize t)
+{
+    i32 tx0 = (t % RASTER_TILES_X) * RASTER_TILE;
+    i32 ty0 = (t / RASTER_TILES_X) * RASTER_TILE;
+    i32 tx1 = tx0 + RASTER_TILE < WIDTH ? tx0 + RASTER_TILE : WIDTH;
+    i32 ty1 = ty0 + RASTER_TILE < HEIGHT ? ty0 + RASTER_TILE : HEIGHT;
+
+    if (clear_pending) {
+        for (i32 y = ty0; y < ty1; y++) {
+            fill_span(&framebuffer[y * WIDTH], tx0, tx1, clear_color, 255);
+        }
+    }
+
+    u64 pixels = 0;
+    for (usize i = 0; i < tile_lengths[t]; i++) {
+        const Prim *p = &prims[tile_prims[t][i]];
+        i32 y0 = p->min_y > ty0 ? p->min_y : ty0;
+        i32 y1 = p->max_y < ty1 ? p->max_y : ty1;
+        i32 bx0 = p->min_x > tx0 ? p->min_x : tx0;
+        i32 bx1 = p->max_x < tx1 ? p->max_x : tx1;
+        for (i32 y = y0; y < y1; y++) {
+            i64 py = (i64) y * SUBPIXEL + SUBPIXEL / 2;
+            i64 x0 = bx0;
+            i64 x1 = bx1 - 1;
+            for (usize e = 0; e < p->n && x0 <= x1; e++) {
+                // Solve a * px + b * py + c >= bias for px = x * SUBPIXEL + SUBPIXEL / 2
+                i64 k = p->a[e] * SUBPIXEL;
+                i64 r = p->bias[e] - p->b[e] * py - p->c[e] - p->a[e] * (SUBPIXEL / 2);
+                if (k > 0) {
+                    i64 lo = ceil_div(r, k);
+                    if (lo > x0) x0 = lo;
+                } else if (k < 0) {
+                    i64 hi = floor_div(r, k);
+                    if (hi < x1) x1 = hi;
+                } else if (r > 0) {
+                    x1 = x0 - 1;
+                }
+            }
+            if (x0 <= x1) {
+                fill_span(&framebuffer[y * WIDTH], x0, x1 + 1, p->color, p->alpha);
+                pixels += x1 + 1 - x0;
+            }
+        }
+    }
+    tile_pixels[t] = pixels;
+}
+
+/* Job over a run of tiles; every tile is written by one thread */
+static void raster_tiles(void *aux, usize begin, usize end, usize thread)
+{
+    (void) aux;
+    (void) thread;
+    for (usize t = begin; t < end; t++) {
+        if (clear_pending || tile_lengths[t] > 0) {
+            raster_tile(t);
+        }
+    }
+}
+
+void raster_init(void)
+{
+    raster_clear((Color) { .r = 1.0, .g = 1.0, .b = 1.0, .a = 1.0 });
+    raster_flush();
+    memset(&stats, 0, sizeof(stats));
+}
+
+void raster_clear(Color c)
+{
+    u8 alpha;
+    clear_color = pack_color(c, &alpha);
+    clear_pending = true;
+    num_prims = 0;
+    memset(tile_lengths, 0, sizeof(tile_lengths));
+}
+
+void raster_polygon(const Polygon *poly, Color c)
+{
+    if (poly->n < 3) {
+        return;
+    }
+
+    i64 xs[MAX_POINTS];
+    i64 ys[MAX_POINTS];
+    i64 min_x = INT32_MAX, min_y = INT32_MAX;
+    i64 max_x = INT32_MIN, max_y = INT32_MIN;
+    i64 area = 0;
+    for (usize i = 0; i < poly->n; i++) {
+        Vector2 v = poly->points[i];
+        xs[i] = llround((scalar_to_f64(v.x) + WIDTH / 2.0) * SUBPIXEL);
+        ys[i] = llround((-scalar_to_f64(v.y) + HEIGHT / 2.0) * SUBPIXEL);
+        if (xs[i] < min_x) min_x = xs[i];
+        if (ys[i] < min_y) min_y = ys[i];
+        if (xs[i] > max_x) max_x = xs[i];
+        if (ys[i] > max_y) max_y = ys[i];
+    }
+    for (usize i = 0; i < poly->n; i++) {
+        usize j = (i + 1) % poly->n;
+        area += xs[i] * ys[j] - xs[j] * ys[i];
+    }
+
+    // Pixel bounds of the polygon, clipped to the screen
+    i64 px0 = ceil_div(min_x - SUBPIXEL / 2, SUBPIXEL);
+    i64 py0 = ceil_div(min_y - SUBPIXEL / 2, SUBPIXEL);
+    i64 px1 = floor_div(max_x - SUBPIXEL / 2, SUBPIXEL) + 1;
+    i64 py1 = floor_div(max_y - SUBPIXEL / 2, SUBPIXEL) + 1;
+    if (px0 < 0) px0 = 0;
+    if (py0 < 0) py0 = 0;
+    if (px1 > WIDTH) px1 = WIDTH;
+    if (py1 > HEIGHT) py1 = HEIGHT;
+
+    u8 alpha;
+    Pixel color = pack_color(c, &alpha);
+    if (area == 0 || alpha == 0 || px0 >= px1 || py0 >= py1) {
+        return;
+    }
+
+    usize t0x = px0 / RASTER_TILE, t1x = (px1 - 1) / RASTER_TILE;
+    usize t0y = py0 / RASTER_TILE, t1y = (py1 - 1) / RASTER_TILE;
+    bool full = num_prims == RASTER_MAX_PRIMS;
+    for (usize ty = t0y; ty <= t1y && !full; ty++) {
+        for (usize tx = t0x; tx <= t1x && !full; tx++) {
+            full = tile_lengths[ty * RASTER_TILES_X + tx] == RASTER_MAX_TILE_PRIMS;
+        }
+    }
+    if (full) {
+        raster_flush();
+    }
+
+    Prim *p = &prims[num_prims];
+    i64 sign = area > 0 ? 1 : -1;
+    for (usize i = 0; i < poly->n; i++) {
+        usize j = (i + 1) % poly->n;
+        // Edge function, positive on the interior side of edge i -> j
+        p->a[i] = -sign * (ys[j] - ys[i]);
+        p->b[i] = sign * (xs[j] - xs[i]);
+        p->c[i] = -(p->a[i] * xs[i] + p->b[i] * ys[i]);
+        // Top-left rule: only left and top edges own the pixels they cross
+        bool top_left = p->a[i] > 0 || (p->a[i] == 0 && p->b[i] > 0);
+        p->bias[i] = top_left ? 0 : 1;
+    }
+    p->n = poly->n;
+    p->min_x = px0;
+    p->min_y = py0;
+    p->max_x = px1;
+    p->max_y = py1;
+    p->color = color;
+    p->alpha = alpha;
+
+    for (usize ty = t0y; ty <= t1y; ty++) {
+        for (usize tx = t0x; tx <= t1x; tx++) {
+            usize t = ty * RASTER_TILES_X + tx;
+            tile_prims[t][tile_lengths[t]] = num_prims;
+            tile_lengths[t] += 1;
+            memory_use(&pools[TILE_POOL], tile_lengths[t]);
+        }
+    }
+    num_prims += 1;
+    memory_use(&pools[PRIM_POOL], num_prims);
+    stats.polygons += 1;
+}
+
+void raster_flush(void)
+{
+    if (!clear_pending && num_prims == 0) {
+        return;
+    }
+
+    memset(tile_pixels, 0, sizeof(tile_pixels));
+    jobs_parallel_for(RASTER_TILES, 1, raster_tiles, NULL);
+
+    for (usize t = 0; t < RASTER_TILES; t++) {
+        stats.pixels += tile_pixels[t];
+    }
+    stats.flushes += 1;
+    clear_pending = false;
+    num_prims = 0;
+    memset(tile_lengths, 0, sizeof(tile_lengths));
+}
+
+const Pixel *raster_pixels(void)
+{
+    return framebuffer;
+}
+
+RasterStats raster_stats(void)
+{
+    return stats;
+}
+
+usize raster_memory(const MemoryPool **out)
+{
+    *out = pools;
+    return NUM_POOLS;
+}
+
+u64 raster_hash(void)
+{
+    const u8 *bytes = (const u8 *) framebuffer;
+    u64 hash = 0xcbf29ce484222325;
+    for (usize i = 0; i < sizeof(framebuffer); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+bool raster_write_ppm(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+    for (usize i = 0; i < WIDTH * HEIGHT; i++) {
+        u8 rgb[3] = {
+            framebuffer[i] & 0xff,
+            (framebuffer[i] >> 8) & 0xff,
+            (framebuffer[i] >> 16) & 0xff,
+        };
+        fwrite(rgb, 1, sizeof(rgb), file);
+    }
+    return fclose(file) == 0;
+}
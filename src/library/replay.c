@@ -0,0 +1,281 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "replay.h"
+
+static FILE *file;
+static bool active;
+static ReplayHeader header;
+static ReplayKeyframe keys[REPLAY_MAX_KEYFRAMES];
+static ReplayStats stats;
+
+// Index rebuilt by the reader for a file that was never closed
+static ReplayKeyframe recovered[REPLAY_MAX_KEYFRAMES];
+
+// The high water is the most keyframes written to one file
+static MemoryPool pool = { "replay index", sizeof(keys) + sizeof(recovered),
+                           REPLAY_MAX_KEYFRAMES, 0 };
+_Static_assert(sizeof(keys) + sizeof(recovered) <= MEMORY_BUDGET_IO,
+        "replay index exceeds the I/O budget");
+
+static void put(const void *data, usize bytes)
+{
+    if (stats.failed) {
+        return;
+    }
+    if (fwrite(data, 1, bytes, file) != bytes) {
+        stats.failed = true;
+        return;
+    }
+    stats.bytes += bytes;
+}
+
+bool replay_open(
+    const char *path,
+    usize state_bytes,
+    usize input_bytes,
+    u32 interval,
+    u32 rules,
+    const char *tag)
+{
+    if (active || interval == 0) {
+        return false;
+    }
+    file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    header = (ReplayHeader) {
+        .magic = REPLAY_MAGIC,
+        .version = REPLAY_VERSION,
+        .state_bytes = (u32) state_bytes,
+        .input_bytes = (u32) input_bytes,
+        .interval = interval,
+        .rules = rules,
+    };
+    snprintf(header.tag, sizeof(header.tag), "%s", tag);
+    stats = (ReplayStats) { 0 };
+    active = true;
+    return true;
+}
+
+bool replay_active(void)
+{
+    return active;
+}
+
+void replay_record(u64 tick, const void *state, const void *input)
+{
+    if (!active || stats.failed) {
+        return;
+    }
+    if (stats.ticks == 0) {
+        // The header waits for the first tick
+        header.first_tick = tick;
+        put(&header, sizeof(header));
+    } else if (tick != header.first_tick + stats.ticks) {
+        fprintf(stderr, "replay: tick %lu does not follow %lu, recording stopped\n",
+                tick, header.first_tick + stats.ticks - 1);
+        stats.failed = true;
+        return;
+    }
+    u64 rel = tick - header.first_tick;
+    if (rel % header.interval == 0 && stats.keyframes < REPLAY_MAX_KEYFRAMES) {
+        keys[stats.keyframes] = (ReplayKeyframe) { .tick = tick, .offset = stats.bytes };
+        put(state, header.state_bytes);
+        stats.keyframes += 1;
+        memory_use(&pool, stats.keyframes);
+    }
+    put(input, header.input_bytes);
+    stats.ticks += !stats.failed;
+}
+
+ReplayStats replay_close(void)
+{
+    if (!active) {
+        return stats;
+    }
+    if (stats.ticks == 0) {
+        put(&header, sizeof(header));
+    }
+    ReplayFooter footer = {
+        .index_offset = stats.bytes,
+        .keyframes = stats.keyframes,
+        .ticks = stats.ticks,
+        .magic = REPLAY_MAGIC,
+    };
+    put(keys, stats.keyframes * sizeof(ReplayKeyframe));
+    put(&footer, sizeof(footer));
+    if (fclose(file)) {
+        stats.failed = true;
+    }
+    file = NULL;
+    active = false;
+    return stats;
+}
+
+usize replay_memory(const MemoryPool **pools)
+{
+    *pools = &pool;
+    return 1;
+}
+
+/* The footer's index, if the file has a whole one */
+static bool read_footer(Replay *replay)
+{
+    const ReplayHeader *h = replay->header;
+    if (replay->length < sizeof(ReplayHeader) + sizeof(ReplayFooter)) {
+        return false;
+    }
+    ReplayFooter footer;
+    memcpy(&footer, replay->data + replay->length - sizeof(footer), sizeof(footer));
+    if (footer.magic != REPLAY_MAGIC ||
+        footer.keyframes > (replay->length - sizeof(footer)) / sizeof(ReplayKeyframe) ||
+        footer.index_offset + footer.keyframes * sizeof(ReplayKeyframe) + sizeof(footer) !=
+            replay->length)
+    {
+        return false;
+    }
+    const ReplayKeyframe *entries = (const ReplayKeyframe *) (replay->data + footer.index_offset);
+    for (u64 k = 0; k < footer.keyframes; k++) {
+        if (entries[k].offset + h->state_bytes > footer.index_offset) {
+            return false;
+        }
+    }
+    replay->index = entries;
+    replay->keyframes = footer.keyframes;
+    replay->ticks = footer.ticks;
+    return true;
+}
+
+/* Walk the layout of an unclosed file up to its last whole record */
+static void recover_index(Replay *replay)
+{
+    const ReplayHeader *h = replay->header;
+    usize offset = sizeof(ReplayHeader);
+    u64 keyframes = 0;
+    u64 ticks = 0;
+    while (keyframes < REPLAY_MAX_KEYFRAMES && offset + h->state_bytes <= replay->length) {
+        recovered[keyframes] = (ReplayKeyframe) {
+            .tick = h->first_tick + keyframes * h->interval,
+            .offset = offset,
+        };
+        keyframes += 1;
+        offset += h->state_bytes;
+        u64 inputs = (replay->length - offset) / h->input_bytes;
+        if (inputs > h->interval) {
+            inputs = h->interval;
+        }
+        ticks += inputs;
+        offset += inputs * h->input_bytes;
+        if (inputs < h->interval) {
+            break;
+        }
+    }
+    if (keyframes == REPLAY_MAX_KEYFRAMES) {
+        ticks += (replay->length - offset) / h->input_bytes;
+    }
+    replay->index = recovered;
+    replay->keyframes = keyframes;
+    replay->ticks = ticks;
+    replay->recovered = true;
+}
+
+bool replay_load(
+    const char *path,
+    Replay *replay,
+    usize state_bytes,
+    usize input_bytes,
+    const char *tag)
+{
+    *replay = (Replay) { 0 };
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open replay %s\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || (usize) st.st_size < sizeof(ReplayHeader)) {
+        fprintf(stderr, "Replay %s is too short\n", path);
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "Unable to map replay %s\n", path);
+        return false;
+    }
+    replay->data = mem;
+    replay->length = st.st_size;
+    replay->header = mem;
+
+    const ReplayHeader *h = replay->header;
+    if (h->magic != REPLAY_MAGIC || h->version != REPLAY_VERSION) {
+        fprintf(stderr, "%s is not a version %d replay\n", path, REPLAY_VERSION);
+        replay_unload(replay);
+        return false;
+    }
+    if (h->state_bytes != state_bytes || h->input_bytes != input_bytes ||
+        strncmp(h->tag, tag, REPLAY_TAG_BYTES) || h->interval == 0)
+    {
+        fprintf(stderr, "Replay %s was written by another build (%.*s, %u byte states)\n",
+                path, REPLAY_TAG_BYTES, h->tag, h->state_bytes);
+        replay_unload(replay);
+        return false;
+    }
+    if (!read_footer(replay)) {
+        recover_index(replay);
+    }
+    if (replay->keyframes == 0) {
+        fprintf(stderr, "Replay %s has no keyframes\n", path);
+        replay_unload(replay);
+        return false;
+    }
+    return true;
+}
+
+void replay_unload(Replay *replay)
+{
+    if (replay->data) {
+        munmap((void *) replay->data, replay->length);
+    }
+    *replay = (Replay) { 0 };
+}
+
+const ReplayKeyframe *replay_keyframe(const Replay *replay, u64 tick)
+{
+    if (replay->keyframes == 0 || tick < replay->header->first_tick ||
+        tick > replay_end(replay))
+    {
+        return NULL;
+    }
+    // Keyframe ticks are increasing, find the last one at or before tick
+    u64 lo = 0;
+    u64 hi = replay->keyframes;
+    while (hi - lo > 1) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (replay->index[mid].tick <= tick) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return &replay->index[lo];
+}
+
+const void *replay_input(const Replay *replay, u64 tick)
+{
+    if (tick >= replay_end(replay)) {
+        return NULL;
+    }
+    const ReplayKeyframe *key = replay_keyframe(replay, tick);
+    if (!key) {
+        return NULL;
+    }
+    const ReplayHeader *h = replay->header;
+    return replay->data + key->offset + h->state_bytes + (tick - key->tick) * h->input_bytes;
+}
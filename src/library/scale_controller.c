@@ -0,0 +1,45 @@
+#include "scale_controller.h"
+
+const f64 SCALE_SMOOTHING = 0.1;
+const f64 SCALE_OVER_BUDGET = 1.05;
+const f64 SCALE_UNDER_BUDGET = 0.8;
+const f64 SCALE_RAISE_STEP = 1.03;
+const f64 SCALE_QUANTUM = 1.0 / 64.0;
+const usize SCALE_COOLDOWN_FRAMES = 15;
+
+void scale_controller_init(ScaleController *ctrl, f64 budget, f64 min_scale)
+{
+    ctrl->scale = 1.0;
+    ctrl->min_scale = min_scale;
+    ctrl->max_scale = 1.0;
+    ctrl->budget = budget;
+    ctrl->average = budget;
+    ctrl->cooldown = 0;
+}
+
+f64 scale_controller_update(ScaleController *ctrl, f64 frame_time)
+{
+    ctrl->average += SCALE_SMOOTHING * (frame_time - ctrl->average);
+    if (ctrl->cooldown > 0) {
+        ctrl->cooldown -= 1;
+        return ctrl->scale;
+    }
+
+    // Snap to a coarse grid so the scale does not jitter between near values
+    f64 scale = ctrl->scale;
+    if (ctrl->average > SCALE_OVER_BUDGET * ctrl->budget) {
+        scale *= sqrt(ctrl->budget / ctrl->average);
+        scale = floor(scale / SCALE_QUANTUM) * SCALE_QUANTUM;
+    } else if (ctrl->average < SCALE_UNDER_BUDGET * ctrl->budget) {
+        scale *= SCALE_RAISE_STEP;
+        scale = ceil(scale / SCALE_QUANTUM) * SCALE_QUANTUM;
+    }
+    if (scale < ctrl->min_scale) scale = ctrl->min_scale;
+    if (scale > ctrl->max_scale) scale = ctrl->max_scale;
+
+    if (scale != ctrl->scale) {
+        ctrl->scale = scale;
+        ctrl->cooldown = SCALE_COOLDOWN_FRAMES;
+    }
+    return ctrl->scale;
+}
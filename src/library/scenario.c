@@ -0,0 +1,70 @@
+#include <string.h>
+
+#include "scenario.h"
+
+bool scenario_load(const char *path, Scenario *scenario)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char line[256];
+    usize line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line_number += 1;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char key[32];
+        unsigned long long a, b, c;
+        int n = sscanf(line, "%31s %llu %llu %llu", key, &a, &b, &c);
+        if (n <= 0) {
+            continue;
+        }
+        if (!strcmp(key, "duration") && n == 2) {
+            scenario->duration = a;
+        } else if (!strcmp(key, "asteroids") && n == 2) {
+            scenario->asteroids = a;
+        } else if (!strcmp(key, "max_asteroids") && n == 2) {
+            scenario->max_asteroids = a;
+        } else if (!strcmp(key, "restart_every") && n == 2) {
+            scenario->restart_every = a;
+        } else if (!strcmp(key, "wave") && (n == 3 || n == 4)) {
+            if (scenario->num_waves == SCENARIO_MAX_WAVES) {
+                fprintf(stderr, "%s:%lu: more than %d waves\n",
+                        path, line_number, SCENARIO_MAX_WAVES);
+                ok = false;
+                break;
+            }
+            ScenarioWave *wave = &scenario->waves[scenario->num_waves];
+            wave->tick = a;
+            wave->count = b;
+            wave->period = n == 4 ? c : 0;
+            scenario->num_waves += 1;
+        } else {
+            fprintf(stderr, "%s:%lu: unrecognized setting: %s", path, line_number, line);
+            ok = false;
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+usize scenario_spawns(const Scenario *scenario, u64 tick)
+{
+    usize count = 0;
+    for (usize i = 0; i < scenario->num_waves; i++) {
+        const ScenarioWave *wave = &scenario->waves[i];
+        if (tick == wave->tick ||
+            (wave->period > 0 && tick > wave->tick &&
+             (tick - wave->tick) % wave->period == 0)) {
+            count += wave->count;
+        }
+    }
+    return count;
+}
@@ -9,12 +9,22 @@
 #include "polygon.h"
 #include "color.h"
 #include "sdl_wrapper.h"
+#include "timer.h"
+
+/*
+ * Sprite atlas: square cells, each holding one shape centered on its
+ * centroid, found through an open-addressed table keyed by shape.
+ */
+#define SPRITE_CELL 128
+#define SPRITE_CELLS ((SPRITE_ATLAS / SPRITE_CELL) * (SPRITE_ATLAS / SPRITE_CELL))
+#define SPRITE_SLOTS (2 * SPRITE_CELLS)
+
+typedef struct {
+    u32 key;
+    i16 cell;
+} SpriteSlot;
 
 const char *WINDOW_TITLE = "Game";
-const Vector2 origin = {
-    .x = WIDTH / 2.0,
-    .y = HEIGHT / 2.0,
-};
 const f64 MS_PER_SEC = 1000.0;
 SDL_Window *window;
 SDL_Renderer *renderer;
@@ -24,11 +34,40 @@ Mix_Chunk *hit;
 Mix_Chunk *thrust;
 Mix_Chunk *game_over;
 TTF_Font *score_font;
+TTF_Font *debug_font;
+SDL_Texture *target;
+SDL_Texture *atlas;
 static i16 x_points[MAX_POINTS];
 static i16 y_points[MAX_POINTS];
 static u64 prev_tick = 0;
 static KeyHandler key_handler;
 static u32 key_start_timestamp;
+static bool sounds_muted;
+static f64 render_scale = 1.0;
+static bool frame_finished;
+static u64 frame_start;
+static f64 cpu_time;
+static f64 gpu_time;
+static char debug_text[128];
+static SpriteSlot sprite_slots[SPRITE_SLOTS];
+static u32 cell_keys[SPRITE_CELLS];
+static u64 cell_frames[SPRITE_CELLS];
+static u64 frame_count;
+static usize num_sprites;
+
+// Textures live on the GPU, counted here at 4 bytes a pixel
+enum { POINT_POOL, SPRITE_POOL, ATLAS_POOL, TARGET_POOL, NUM_POOLS };
+static MemoryPool pools[NUM_POOLS] = {
+    [POINT_POOL] = { "point scratch", sizeof(x_points) + sizeof(y_points), MAX_POINTS, 0 },
+    [SPRITE_POOL] = { "sprite table",
+                      sizeof(sprite_slots) + sizeof(cell_keys) + sizeof(cell_frames),
+                      SPRITE_CELLS, 0 },
+    [ATLAS_POOL] = { "atlas texture", SPRITE_ATLAS * SPRITE_ATLAS * 4, SPRITE_CELLS, 0 },
+    [TARGET_POOL] = { "render target", WIDTH * HEIGHT * 4, 1, 1 },
+};
+_Static_assert(sizeof(x_points) + sizeof(y_points) + sizeof(sprite_slots) + sizeof(cell_keys) +
+        sizeof(cell_frames) + (SPRITE_ATLAS * SPRITE_ATLAS + WIDTH * HEIGHT) * 4ull
+        <= MEMORY_BUDGET_RENDER, "SDL pools exceed the render budget");
 
 void sdl_init(void)
 {
@@ -44,7 +83,13 @@ void sdl_init(void)
         WIDTH,
         HEIGHT,
         0);
-    renderer = SDL_CreateRenderer(window, -1, 0);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_TARGETTEXTURE);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+    target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+    atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET, SPRITE_ATLAS, SPRITE_ATLAS);
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
     Mix_Init(MIX_INIT_OGG);
     Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 1024);
     Mix_ReserveChannels(1);
@@ -55,6 +100,7 @@ void sdl_init(void)
     game_over = Mix_LoadWAV("sounds/game_over.wav");
     TTF_Init();
     score_font = TTF_OpenFont("fonts/RobotoMono-Regular.ttf", 75);
+    debug_font = TTF_OpenFont("fonts/RobotoMono-Light.ttf", 18);
 }
 
 void sdl_render_score(usize score)
@@ -72,7 +118,9 @@ void sdl_render_score(usize score)
 
     i32 w, h;
     SDL_QueryTexture(texture, NULL, NULL, &w, &h);
-    SDL_Rect r = (SDL_Rect) { (width - w) / 2, 0, w, h };
+    w *= render_scale;
+    h *= render_scale;
+    SDL_Rect r = (SDL_Rect) { (width * render_scale - w) / 2, 0, w, h };
 
     SDL_RenderCopy(renderer, texture, NULL, &r);
 
@@ -81,29 +129,39 @@ void sdl_render_score(usize score)
 }
 
 
+void sdl_mute(bool muted)
+{
+    sounds_muted = muted;
+}
+
 void sdl_play_start(void)
 {
+    if (sounds_muted) return;
     Mix_PlayChannel(-1, start, 0);
 }
 
 void sdl_play_shoot(void)
 {
+    if (sounds_muted) return;
     Mix_PlayChannel(-1, shoot, 0);
 }
 
 void sdl_play_hit(void)
 {
+    if (sounds_muted) return;
     Mix_PlayChannel(-1, hit, 0);
 }
 
 void sdl_play_game_over(void)
 {
+    if (sounds_muted) return;
     Mix_Volume(0, MIX_MAX_VOLUME);
     Mix_PlayChannel(0, game_over, 0);
 }
 
 void sdl_play_thrust(void)
 {
+    if (sounds_muted) return;
     Mix_Volume(0, MIX_MAX_VOLUME);
     Mix_PlayChannel(0, thrust, -1);
 }
@@ -155,7 +213,9 @@ bool sdl_running(void *aux)
                 KeyEventType type =
                     event.type == SDL_KEYDOWN ? KEY_PRESSED : KEY_RELEASED;
                 f64 held_time = (timestamp - key_start_timestamp) / MS_PER_SEC;
-                key_handler(key, type, held_time, aux);
+                // Event timestamps are SDL ticks, move them to our clock
+                f64 arrival = timer_now() - (SDL_GetTicks() - timestamp) / MS_PER_SEC;
+                key_handler(key, type, held_time, arrival, aux);
                 break;
 
             } break;
@@ -164,29 +224,259 @@ bool sdl_running(void *aux)
     return true;
 }
 
+/* Size of the region of the offscreen target drawn at the current scale */
+SDL_Rect scaled_rect(void)
+{
+    return (SDL_Rect) { 0, 0, WIDTH * render_scale, HEIGHT * render_scale };
+}
+
 void sdl_clear(void)
 {
+    frame_start = SDL_GetPerformanceCounter();
+    frame_finished = false;
+    SDL_SetRenderTarget(renderer, target);
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    SDL_RenderClear(renderer);
+    if (target) {
+        SDL_Rect r = scaled_rect();
+        SDL_RenderFillRect(renderer, &r);
+    } else {
+        SDL_RenderClear(renderer);
+    }
 }
 
 void sdl_draw_polygon(const Polygon *poly, Color c)
 {
+    memory_use(&pools[POINT_POOL], poly->n);
     for (usize i = 0; i < poly->n; i++) {
         Vector2 v = poly->points[i];
-        v = vec_add(v, origin);
-        v.y = -v.y + HEIGHT;
-        x_points[i] = (i16) v.x;
-        y_points[i] = (i16) v.y;
+        x_points[i] = (i16) ((scalar_to_f64(v.x) + WIDTH / 2.0) * render_scale);
+        y_points[i] = (i16) ((-scalar_to_f64(v.y) + HEIGHT / 2.0) * render_scale);
     }
 
     filledPolygonRGBA(renderer, x_points, y_points, poly->n,
             255 * c.r, 255 * c.g, 255 * c.b, 255 * c.a);
 }
 
+void render_debug_text(void)
+{
+    if (debug_text[0] == '\0' || debug_font == NULL) {
+        return;
+    }
+    SDL_Color red = { 255, 0, 0 };
+    SDL_Surface *surface = TTF_RenderUTF8_Solid(debug_font, debug_text, red);
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    i32 w, h;
+    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+    SDL_Rect r = (SDL_Rect) { 8, HEIGHT - h - 8, w, h };
+    SDL_RenderCopy(renderer, texture, NULL, &r);
+    SDL_FreeSurface(surface);
+    SDL_DestroyTexture(texture);
+}
+
+/* Upscale the offscreen target to the window and draw the overlay */
+void finish_frame(void)
+{
+    if (frame_finished) {
+        return;
+    }
+    if (target) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_Rect src = scaled_rect();
+        SDL_RenderCopy(renderer, target, &src, NULL);
+    }
+    render_debug_text();
+    frame_finished = true;
+}
+
+void sdl_read_frame(u8 *rgba)
+{
+    finish_frame();
+    SDL_RenderReadPixels(
+            renderer, NULL, SDL_PIXELFORMAT_ABGR8888, rgba, WIDTH * 4);
+}
+
+usize sprite_slot(u32 key)
+{
+    return (key * 2654435761u) % SPRITE_SLOTS;
+}
+
+/* Slot holding key, or the empty slot where it would be inserted */
+SpriteSlot *find_sprite(u32 key)
+{
+    usize i = sprite_slot(key);
+    while (sprite_slots[i].key != 0 && sprite_slots[i].key != key) {
+        i = (i + 1) % SPRITE_SLOTS;
+    }
+    return &sprite_slots[i];
+}
+
+/* Remove key, shifting later entries of its probe run back into the gap */
+void remove_sprite(u32 key)
+{
+    SpriteSlot *slot = find_sprite(key);
+    if (slot->key == 0) {
+        return;
+    }
+    cell_keys[slot->cell] = 0;
+    num_sprites -= 1;
+    usize gap = slot - sprite_slots;
+    usize i = gap;
+    for (;;) {
+        i = (i + 1) % SPRITE_SLOTS;
+        if (sprite_slots[i].key == 0) {
+            break;
+        }
+        usize home = sprite_slot(sprite_slots[i].key);
+        bool movable = gap <= i ? (home <= gap || home > i) : (home <= gap && home > i);
+        if (movable) {
+            sprite_slots[gap] = sprite_slots[i];
+            gap = i;
+        }
+    }
+    sprite_slots[gap].key = 0;
+}
+
+/* A free cell, evicting the least recently drawn shape if there is none */
+i16 alloc_cell(void)
+{
+    usize lru = 0;
+    for (usize i = 0; i < SPRITE_CELLS; i++) {
+        if (cell_keys[i] == 0) {
+            return i;
+        }
+        if (cell_frames[i] < cell_frames[lru]) {
+            lru = i;
+        }
+    }
+    if (cell_frames[lru] == frame_count) {
+        return -1;
+    }
+    remove_sprite(cell_keys[lru]);
+    return lru;
+}
+
+/* Write the unrotated shape, centered on cent, into the point buffers */
+bool sprite_points(const Polygon *poly, Vector2 cent, f64 theta)
+{
+    memory_use(&pools[POINT_POOL], poly->n);
+    for (usize i = 0; i < poly->n; i++) {
+        Vector2 v = vec_rotate(-theta, vec_sub(poly->points[i], cent));
+        f64 x = scalar_to_f64(v.x);
+        f64 y = scalar_to_f64(v.y);
+        if (fabs(x) >= SPRITE_CELL / 2 || fabs(y) >= SPRITE_CELL / 2) {
+            return false;
+        }
+        x_points[i] = (i16) x;
+        y_points[i] = (i16) -y;
+    }
+    return true;
+}
+
+void rasterize_sprite(i16 cell, const Polygon *poly)
+{
+    i32 cx = (cell % (SPRITE_ATLAS / SPRITE_CELL)) * SPRITE_CELL + SPRITE_CELL / 2;
+    i32 cy = (cell / (SPRITE_ATLAS / SPRITE_CELL)) * SPRITE_CELL + SPRITE_CELL / 2;
+    for (usize i = 0; i < poly->n; i++) {
+        x_points[i] += cx;
+        y_points[i] += cy;
+    }
+
+    SDL_Rect r = { cx - SPRITE_CELL / 2, cy - SPRITE_CELL / 2, SPRITE_CELL, SPRITE_CELL };
+    SDL_SetRenderTarget(renderer, atlas);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+    SDL_RenderFillRect(renderer, &r);
+    filledPolygonRGBA(renderer, x_points, y_points, poly->n, 255, 255, 255, 255);
+    SDL_SetRenderTarget(renderer, target);
+}
+
+bool sdl_draw_sprite(u32 shape, const Polygon *poly, Vector2 cent, f64 theta, Color c)
+{
+    if (atlas == NULL || shape == 0) {
+        return false;
+    }
+    SpriteSlot *slot = find_sprite(shape);
+    if (slot->key == 0) {
+        if (!sprite_points(poly, cent, theta)) {
+            return false;
+        }
+        i16 cell = alloc_cell();
+        if (cell < 0) {
+            return false;
+        }
+        rasterize_sprite(cell, poly);
+        // Evicting may have moved entries around, so look the slot up again
+        slot = find_sprite(shape);
+        slot->key = shape;
+        slot->cell = cell;
+        cell_keys[cell] = shape;
+        num_sprites += 1;
+        memory_use(&pools[SPRITE_POOL], num_sprites);
+        memory_use(&pools[ATLAS_POOL], num_sprites);
+    }
+    cell_frames[slot->cell] = frame_count;
+
+    SDL_Rect src = {
+        (slot->cell % (SPRITE_ATLAS / SPRITE_CELL)) * SPRITE_CELL,
+        (slot->cell / (SPRITE_ATLAS / SPRITE_CELL)) * SPRITE_CELL,
+        SPRITE_CELL,
+        SPRITE_CELL,
+    };
+    f64 size = SPRITE_CELL * render_scale;
+    SDL_Rect dst = {
+        (scalar_to_f64(cent.x) + WIDTH / 2.0) * render_scale - size / 2,
+        (-scalar_to_f64(cent.y) + HEIGHT / 2.0) * render_scale - size / 2,
+        size,
+        size,
+    };
+    SDL_SetTextureColorMod(atlas, 255 * c.r, 255 * c.g, 255 * c.b);
+    SDL_SetTextureAlphaMod(atlas, 255 * c.a);
+    SDL_RenderCopyEx(renderer, atlas, &src, &dst, -theta * 180.0 / M_PI, NULL, SDL_FLIP_NONE);
+    return true;
+}
+
+void sdl_release_sprite(u32 shape)
+{
+    if (shape != 0) {
+        remove_sprite(shape);
+    }
+}
+
 void sdl_show(void)
 {
+    finish_frame();
+    u64 freq = SDL_GetPerformanceFrequency();
+    u64 present_start = SDL_GetPerformanceCounter();
+    cpu_time = (f64) (present_start - frame_start) / (f64) freq;
     SDL_RenderPresent(renderer);
+    frame_count += 1;
+    gpu_time = (f64) (SDL_GetPerformanceCounter() - present_start) / (f64) freq;
+}
+
+void sdl_set_render_scale(f64 scale)
+{
+    if (target == NULL) {
+        return;
+    }
+    if (scale > 1.0) scale = 1.0;
+    if (scale < 1.0 / 16.0) scale = 1.0 / 16.0;
+    render_scale = scale;
+}
+
+f64 sdl_render_scale(void)
+{
+    return render_scale;
+}
+
+void sdl_frame_times(f64 *cpu, f64 *gpu)
+{
+    *cpu = cpu_time;
+    *gpu = gpu_time;
+}
+
+void sdl_set_debug_text(const char *text)
+{
+    snprintf(debug_text, sizeof(debug_text), "%s", text ? text : "");
 }
 
 void sdl_quit(void)
@@ -196,6 +486,9 @@ void sdl_quit(void)
     Mix_FreeChunk(hit);
     Mix_FreeChunk(thrust);
     Mix_FreeChunk(game_over);
+    TTF_CloseFont(debug_font);
+    SDL_DestroyTexture(atlas);
+    SDL_DestroyTexture(target);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -210,3 +503,14 @@ f64 time_since_last_tick(void)
     prev_tick = curr_tick;
     return diff;
 }
+
+bool sdl_is_headless(void)
+{
+    return false;
+}
+
+usize sdl_memory(const MemoryPool **out)
+{
+    *out = pools;
+    return NUM_POOLS;
+}
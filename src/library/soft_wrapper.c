@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "const.h"
+#include "vector.h"
+#include "polygon.h"
+#include "color.h"
+#include "raster.h"
+#include "timer.h"
+#include "sdl_wrapper.h"
+
+/*
+ * Headless implementation of the sdl_wrapper.h API. Frames are drawn by the
+ * software rasterizer into an in-memory framebuffer, sounds and text are
+ * dropped, and the game advances at a fixed timestep for a configurable
+ * number of frames:
+ *
+ *   HEADLESS_FRAMES  number of frames to run before quitting (default 3600)
+ *   HEADLESS_PPM     path to write the last frame to as a PPM image
+ *
+ * Tiles are rasterized on the game's job threads, see JOBS_THREADS.
+ */
+
+const f64 HEADLESS_DT = 1.0 / 60.0;
+const usize DEFAULT_HEADLESS_FRAMES = 3600;
+static usize frame_limit;
+static usize frames;
+static f64 start_time;
+static f64 frame_start;
+static f64 cpu_time;
+
+static usize env_usize(const char *name, usize fallback)
+{
+    const char *value = getenv(name);
+    return value ? (usize) strtoull(value, NULL, 10) : fallback;
+}
+
+void sdl_init(void)
+{
+    frame_limit = env_usize("HEADLESS_FRAMES", DEFAULT_HEADLESS_FRAMES);
+    raster_init();
+    start_time = timer_now();
+}
+
+void sdl_render_score(usize score)
+{
+    (void) score;
+}
+
+void sdl_mute(bool muted)
+{
+    (void) muted;
+}
+
+void sdl_play_start(void) {}
+
+void sdl_play_shoot(void) {}
+
+void sdl_play_hit(void) {}
+
+void sdl_play_game_over(void) {}
+
+void sdl_play_thrust(void) {}
+
+void sdl_stop_thrust(void) {}
+
+void sdl_on_key(KeyHandler handler)
+{
+    (void) handler;
+}
+
+bool sdl_running(void *aux)
+{
+    (void) aux;
+    return frames < frame_limit;
+}
+
+void sdl_clear(void)
+{
+    frame_start = timer_now();
+    raster_clear((Color) { .r = 1.0, .g = 1.0, .b = 1.0, .a = 1.0 });
+}
+
+void sdl_draw_polygon(const Polygon *poly, Color c)
+{
+    raster_polygon(poly, c);
+}
+
+bool sdl_draw_sprite(u32 shape, const Polygon *poly, Vector2 cent, f64 theta, Color c)
+{
+    (void) shape;
+    (void) poly;
+    (void) cent;
+    (void) theta;
+    (void) c;
+    return false;
+}
+
+void sdl_release_sprite(u32 shape)
+{
+    (void) shape;
+}
+
+void sdl_read_frame(u8 *rgba)
+{
+    raster_flush();
+    memcpy(rgba, raster_pixels(), WIDTH * HEIGHT * sizeof(Pixel));
+}
+
+void sdl_show(void)
+{
+    raster_flush();
+    cpu_time = timer_now() - frame_start;
+    frames++;
+}
+
+/* The rasterizer always draws at full resolution */
+void sdl_set_render_scale(f64 scale)
+{
+    (void) scale;
+}
+
+f64 sdl_render_scale(void)
+{
+    return 1.0;
+}
+
+void sdl_frame_times(f64 *cpu, f64 *gpu)
+{
+    *cpu = cpu_time;
+    *gpu = 0.0;
+}
+
+void sdl_set_debug_text(const char *text)
+{
+    (void) text;
+}
+
+void sdl_quit(void)
+{
+    f64 secs = timer_now() - start_time;
+    RasterStats stats = raster_stats();
+    printf("headless: %lu frames in %.3f s (%.1f frames/s)\n",
+            frames, secs, frames / secs);
+    printf("headless: %.0f polygons/s, %.1f Mpix/s\n",
+            stats.polygons / secs, stats.pixels / secs / 1e6);
+    printf("headless: last frame hash %016lx\n", raster_hash());
+
+    const char *ppm = getenv("HEADLESS_PPM");
+    if (ppm && !raster_write_ppm(ppm)) {
+        fprintf(stderr, "Unable to write %s\n", ppm);
+    }
+}
+
+f64 time_since_last_tick(void)
+{
+    return HEADLESS_DT;
+}
+
+bool sdl_is_headless(void)
+{
+    return true;
+}
+
+usize sdl_memory(const MemoryPool **pools)
+{
+    return raster_memory(pools);
+}
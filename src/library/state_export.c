@@ -0,0 +1,104 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "state_export.h"
+
+const usize EXPORT_READ_RETRIES = 1000;
+static ExportSegment *segment;
+static char segment_name[256];
+
+bool export_open(const char *name)
+{
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(ExportSegment))) {
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, sizeof(ExportSegment), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    segment = mem;
+    snprintf(segment_name, sizeof(segment_name), "%s", name);
+
+    __atomic_store_n(&segment->seq, 0, __ATOMIC_RELAXED);
+    memset(&segment->frame, 0, sizeof(segment->frame));
+    segment->version = STATE_EXPORT_VERSION;
+    segment->frame_size = sizeof(ExportFrame);
+    segment->capacity = MAX_ENTITIES;
+    // Readers check the magic last, once the rest of the header is valid
+    __atomic_store_n(&segment->magic, STATE_EXPORT_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+ExportFrame *export_begin(void)
+{
+    u64 seq = __atomic_load_n(&segment->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&segment->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return &segment->frame;
+}
+
+void export_end(void)
+{
+    u64 seq = __atomic_load_n(&segment->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&segment->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void export_close(void)
+{
+    munmap(segment, sizeof(ExportSegment));
+    shm_unlink(segment_name);
+    segment = NULL;
+}
+
+const ExportSegment *export_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    void *mem = mmap(NULL, sizeof(ExportSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    const ExportSegment *seg = mem;
+    if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != STATE_EXPORT_MAGIC ||
+        seg->version != STATE_EXPORT_VERSION ||
+        seg->frame_size != sizeof(ExportFrame))
+    {
+        munmap(mem, sizeof(ExportSegment));
+        return NULL;
+    }
+    return seg;
+}
+
+bool export_read(const ExportSegment *seg, ExportFrame *frame)
+{
+    for (usize i = 0; i < EXPORT_READ_RETRIES; i++) {
+        u64 before = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(frame, &seg->frame, sizeof(ExportFrame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        u64 after = __atomic_load_n(&seg->seq, __ATOMIC_RELAXED);
+        if (before == after) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void export_detach(const ExportSegment *seg)
+{
+    munmap((void *) seg, sizeof(ExportSegment));
+}
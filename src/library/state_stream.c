@@ -0,0 +1,537 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "state_stream.h"
+
+typedef enum {
+    FIELD_X = 1 << 0,
+    FIELD_Y = 1 << 1,
+    FIELD_ANGLE = 1 << 2,
+    FIELD_VX = 1 << 3,
+    FIELD_VY = 1 << 4,
+} StreamField;
+
+typedef struct {
+    const u8 *p;
+    const u8 *end;
+    bool ok;
+} Reader;
+
+static ExportFrame frames[STREAM_POOL];
+static usize free_frames[STREAM_POOL];
+static usize num_free;
+static usize queue[STREAM_POOL];
+static usize queue_head;
+static usize queue_length;
+static StreamEncoder encoder;
+static u8 buffer[STREAM_MAX_FRAME_BYTES];
+
+static bool active;
+static bool stopping;
+static bool failed;
+static bool is_socket;
+static int fd = -1;
+static StreamStats stats;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER;
+
+// The encoder's high water is the longest frame it wrote, in bytes
+enum { FRAME_POOL, ENCODER_POOL, NUM_POOLS };
+static MemoryPool pools[NUM_POOLS] = {
+    [FRAME_POOL] = { "stream frames", sizeof(frames), STREAM_POOL, 0 },
+    [ENCODER_POOL] = { "stream encoder", sizeof(encoder) + sizeof(buffer),
+                       STREAM_MAX_FRAME_BYTES, 0 },
+};
+_Static_assert(sizeof(frames) + sizeof(encoder) + sizeof(buffer) <= MEMORY_BUDGET_IO,
+        "stream pools exceed the I/O budget");
+
+/* Varints are little-endian base 128, signed values are zigzag encoded */
+
+static u8 *put_varint(u8 *p, u64 v)
+{
+    while (v >= 0x80) {
+        *p++ = (u8) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (u8) v;
+    return p;
+}
+
+static u8 *put_zigzag(u8 *p, i64 v)
+{
+    return put_varint(p, ((u64) v << 1) ^ (u64) (v >> 63));
+}
+
+static u64 get_varint(Reader *r)
+{
+    u64 v = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end) {
+            r->ok = false;
+            return 0;
+        }
+        u8 byte = *r->p++;
+        v |= (u64) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return v;
+        }
+    }
+    r->ok = false;
+    return 0;
+}
+
+static i64 get_zigzag(Reader *r)
+{
+    u64 v = get_varint(r);
+    return (i64) (v >> 1) ^ -(i64) (v & 1);
+}
+
+static u8 get_u8(Reader *r)
+{
+    if (r->p == r->end) {
+        r->ok = false;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static StreamEntity quantize(const ExportEntity *e)
+{
+    f64 turns = e->theta / (2.0 * M_PI);
+    turns -= floor(turns);
+    StreamEntity q = {
+        .x = (i32) llround(e->x * STREAM_POS_SCALE),
+        .y = (i32) llround(e->y * STREAM_POS_SCALE),
+        .angle = (u32) llround(turns * STREAM_ANGLE_STEPS) % STREAM_ANGLE_STEPS,
+        .vx = (i32) llround(e->vx * STREAM_VEL_SCALE),
+        .vy = (i32) llround(e->vy * STREAM_VEL_SCALE),
+        .kind = e->kind,
+    };
+    return q;
+}
+
+static ExportEntity dequantize(u32 id, const StreamEntity *q)
+{
+    ExportEntity e = {
+        .id = id,
+        .kind = q->kind,
+        .x = (f64) q->x / STREAM_POS_SCALE,
+        .y = (f64) q->y / STREAM_POS_SCALE,
+        .theta = 2.0 * M_PI * q->angle / STREAM_ANGLE_STEPS,
+        .vx = (f64) q->vx / STREAM_VEL_SCALE,
+        .vy = (f64) q->vy / STREAM_VEL_SCALE,
+    };
+    return e;
+}
+
+/* Shortest signed step between two angles */
+static i64 angle_delta(u32 from, u32 to)
+{
+    i64 d = (i64) ((to - from) % STREAM_ANGLE_STEPS);
+    return d >= STREAM_ANGLE_STEPS / 2 ? d - STREAM_ANGLE_STEPS : d;
+}
+
+usize stream_write_header(u8 *out)
+{
+    u32 magic = STREAM_MAGIC;
+    u16 version = STREAM_VERSION;
+    u8 scales[2] = { STREAM_POS_SCALE, STREAM_VEL_SCALE };
+    memcpy(out, &magic, 4);
+    memcpy(out + 4, &version, 2);
+    memcpy(out + 6, scales, 2);
+    return STREAM_HEADER_BYTES;
+}
+
+void stream_encoder_init(StreamEncoder *enc)
+{
+    memset(&enc->prev, 0, sizeof(enc->prev));
+    enc->frames = 0;
+}
+
+usize stream_encode(StreamEncoder *enc, const ExportFrame *frame, u8 *out)
+{
+    StreamState *prev = &enc->prev;
+    bool key = enc->frames % STREAM_KEYFRAME_INTERVAL == 0;
+    usize num_removed = 0;
+    usize num_spawned = 0;
+    usize num_moved = 0;
+
+    // Sort entities into spawned and moved, by index into the frame
+    memset(enc->seen, 0, sizeof(enc->seen));
+    for (usize i = 0; i < frame->count; i++) {
+        u32 id = frame->entities[i].id;
+        assert(id < MAX_ENTITIES);
+        StreamEntity q = quantize(&frame->entities[i]);
+        const StreamEntity *old = &prev->entities[id];
+        enc->seen[id] = true;
+        if (key || !prev->live[id] || old->kind != q.kind) {
+            // A slot reused by another kind is a removal and a spawn
+            if (!key && prev->live[id]) {
+                enc->removed[num_removed++] = id;
+            }
+            enc->spawned[num_spawned++] = i;
+            continue;
+        }
+        u8 mask = (q.x != old->x ? FIELD_X : 0) |
+                  (q.y != old->y ? FIELD_Y : 0) |
+                  (q.angle != old->angle ? FIELD_ANGLE : 0) |
+                  (q.vx != old->vx ? FIELD_VX : 0) |
+                  (q.vy != old->vy ? FIELD_VY : 0);
+        if (mask) {
+            enc->moved[num_moved] = i;
+            enc->masks[num_moved] = mask;
+            num_moved++;
+        }
+    }
+    if (!key) {
+        for (u32 id = 0; id < MAX_ENTITIES; id++) {
+            if (prev->live[id] && !enc->seen[id]) {
+                enc->removed[num_removed++] = id;
+            }
+        }
+    }
+
+    // Leave room for the longest length prefix, and close the gap after
+    u8 *start = out + 5;
+    u8 *p = start;
+    *p++ = key ? STREAM_KEYFRAME : 0;
+    p = put_zigzag(p, key ? (i64) frame->tick : (i64) (frame->tick - prev->tick));
+    p = put_zigzag(p, key ? (i64) frame->score : (i64) (frame->score - prev->score));
+    *p++ = (u8) frame->status;
+    *p++ = (u8) frame->quality;
+    p = put_varint(p, num_removed);
+    for (usize i = 0; i < num_removed; i++) {
+        p = put_varint(p, enc->removed[i]);
+    }
+    p = put_varint(p, num_spawned);
+    for (usize i = 0; i < num_spawned; i++) {
+        const ExportEntity *e = &frame->entities[enc->spawned[i]];
+        StreamEntity q = quantize(e);
+        p = put_varint(p, e->id);
+        *p++ = (u8) q.kind;
+        p = put_zigzag(p, q.x);
+        p = put_zigzag(p, q.y);
+        p = put_varint(p, q.angle);
+        p = put_zigzag(p, q.vx);
+        p = put_zigzag(p, q.vy);
+    }
+    p = put_varint(p, num_moved);
+    for (usize i = 0; i < num_moved; i++) {
+        const ExportEntity *e = &frame->entities[enc->moved[i]];
+        StreamEntity q = quantize(e);
+        const StreamEntity *old = &prev->entities[e->id];
+        u8 mask = enc->masks[i];
+        p = put_varint(p, e->id);
+        *p++ = mask;
+        if (mask & FIELD_X) p = put_zigzag(p, (i64) q.x - old->x);
+        if (mask & FIELD_Y) p = put_zigzag(p, (i64) q.y - old->y);
+        if (mask & FIELD_ANGLE) p = put_zigzag(p, angle_delta(old->angle, q.angle));
+        if (mask & FIELD_VX) p = put_zigzag(p, (i64) q.vx - old->vx);
+        if (mask & FIELD_VY) p = put_zigzag(p, (i64) q.vy - old->vy);
+    }
+    usize payload = p - start;
+    assert(payload + 5 <= STREAM_MAX_FRAME_BYTES);
+    u8 prefix[5];
+    usize prefix_length = put_varint(prefix, payload) - prefix;
+    memmove(out + prefix_length, start, payload);
+    memcpy(out, prefix, prefix_length);
+
+    // Remember what the decoder will have
+    if (key) {
+        memset(prev->live, 0, sizeof(prev->live));
+    }
+    for (usize i = 0; i < num_removed; i++) {
+        prev->live[enc->removed[i]] = false;
+    }
+    for (usize i = 0; i < frame->count; i++) {
+        u32 id = frame->entities[i].id;
+        prev->entities[id] = quantize(&frame->entities[i]);
+        prev->live[id] = true;
+    }
+    prev->tick = frame->tick;
+    prev->score = frame->score;
+    prev->status = frame->status;
+    prev->quality = frame->quality;
+    enc->frames += 1;
+    return prefix_length + payload;
+}
+
+void stream_decoder_init(StreamDecoder *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+static bool decode_payload(StreamState *state, Reader *r)
+{
+    u8 flags = get_u8(r);
+    if (flags & STREAM_KEYFRAME) {
+        memset(state->live, 0, sizeof(state->live));
+        state->tick = 0;
+        state->score = 0;
+    }
+    state->tick += get_zigzag(r);
+    state->score += get_zigzag(r);
+    state->status = get_u8(r);
+    state->quality = get_u8(r);
+
+    u64 num_removed = get_varint(r);
+    for (u64 i = 0; r->ok && i < num_removed; i++) {
+        u64 id = get_varint(r);
+        if (id >= MAX_ENTITIES) return false;
+        state->live[id] = false;
+    }
+    u64 num_spawned = get_varint(r);
+    for (u64 i = 0; r->ok && i < num_spawned; i++) {
+        u64 id = get_varint(r);
+        if (id >= MAX_ENTITIES) return false;
+        StreamEntity *q = &state->entities[id];
+        q->kind = get_u8(r);
+        q->x = get_zigzag(r);
+        q->y = get_zigzag(r);
+        q->angle = get_varint(r) % STREAM_ANGLE_STEPS;
+        q->vx = get_zigzag(r);
+        q->vy = get_zigzag(r);
+        state->live[id] = true;
+    }
+    u64 num_moved = get_varint(r);
+    for (u64 i = 0; r->ok && i < num_moved; i++) {
+        u64 id = get_varint(r);
+        if (id >= MAX_ENTITIES || !state->live[id]) return false;
+        StreamEntity *q = &state->entities[id];
+        u8 mask = get_u8(r);
+        if (mask & FIELD_X) q->x += get_zigzag(r);
+        if (mask & FIELD_Y) q->y += get_zigzag(r);
+        if (mask & FIELD_ANGLE) {
+            i64 angle = (i64) q->angle + get_zigzag(r) + STREAM_ANGLE_STEPS;
+            q->angle = (u32) (angle % STREAM_ANGLE_STEPS);
+        }
+        if (mask & FIELD_VX) q->vx += get_zigzag(r);
+        if (mask & FIELD_VY) q->vy += get_zigzag(r);
+    }
+    return r->ok && r->p == r->end;
+}
+
+StreamResult stream_decode(
+    StreamDecoder *dec,
+    const u8 *data,
+    usize length,
+    usize *consumed,
+    ExportFrame *frame)
+{
+    usize offset = 0;
+    if (!dec->header_done) {
+        if (length < STREAM_HEADER_BYTES) {
+            return STREAM_NEED_MORE;
+        }
+        u32 magic;
+        u16 version;
+        memcpy(&magic, data, 4);
+        memcpy(&version, data + 4, 2);
+        if (magic != STREAM_MAGIC || version != STREAM_VERSION ||
+            data[6] != STREAM_POS_SCALE || data[7] != STREAM_VEL_SCALE) {
+            return STREAM_ERROR;
+        }
+        offset = STREAM_HEADER_BYTES;
+    }
+
+    Reader r = { .p = data + offset, .end = data + length, .ok = true };
+    u64 payload = get_varint(&r);
+    if (!r.ok || (u64) (r.end - r.p) < payload) {
+        return payload > STREAM_MAX_FRAME_BYTES ? STREAM_ERROR : STREAM_NEED_MORE;
+    }
+    dec->header_done = true;
+    r.end = r.p + payload;
+    if (!decode_payload(&dec->state, &r)) {
+        return STREAM_ERROR;
+    }
+    *consumed = r.end - data;
+
+    const StreamState *state = &dec->state;
+    frame->tick = state->tick;
+    frame->score = state->score;
+    frame->status = state->status;
+    frame->quality = state->quality;
+    frame->count = 0;
+    for (u32 kind = EXPORT_PLAYER; kind <= EXPORT_PARTICLE; kind++) {
+        for (u32 id = 0; id < MAX_ENTITIES; id++) {
+            if (state->live[id] && state->entities[id].kind == kind) {
+                frame->entities[frame->count++] = dequantize(id, &state->entities[id]);
+            }
+        }
+    }
+    return STREAM_FRAME;
+}
+
+void stream_quantize(ExportFrame *frame)
+{
+    for (usize i = 0; i < frame->count; i++) {
+        StreamEntity q = quantize(&frame->entities[i]);
+        frame->entities[i] = dequantize(frame->entities[i].id, &q);
+    }
+}
+
+/* False on an error or a closed peer; a signal only interrupts a write */
+static bool write_all(const u8 *data, usize length)
+{
+    while (length > 0) {
+        ssize_t n = is_socket
+            ? send(fd, data, length, MSG_NOSIGNAL)
+            : write(fd, data, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static void *stream_writer(void *aux)
+{
+    (void) aux;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (queue_length == 0 && !stopping) {
+            pthread_cond_wait(&queued, &lock);
+        }
+        if (queue_length == 0) {
+            break;
+        }
+        usize idx = queue[queue_head];
+        queue_head = (queue_head + 1) % STREAM_POOL;
+        queue_length -= 1;
+        pthread_mutex_unlock(&lock);
+
+        usize length = stream_encode(&encoder, &frames[idx], buffer);
+
+        pthread_mutex_lock(&lock);
+        free_frames[num_free] = idx;
+        num_free += 1;
+        memory_use(&pools[ENCODER_POOL], length);
+        pthread_mutex_unlock(&lock);
+
+        // A viewer that went away stops the stream, not the game
+        bool ok = !failed && write_all(buffer, length);
+
+        pthread_mutex_lock(&lock);
+        failed = !ok;
+        stats.frames += ok;
+        stats.bytes += ok ? length : 0;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int open_target(const char *target)
+{
+    if (strncmp(target, "unix:", 5)) {
+        is_socket = false;
+        return open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(target + 5) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, target + 5);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(sock);
+        return -1;
+    }
+    is_socket = true;
+    return sock;
+}
+
+bool stream_open(const char *target)
+{
+    assert(!active);
+    fd = open_target(target);
+    if (fd < 0) {
+        return false;
+    }
+    u8 header[STREAM_HEADER_BYTES];
+    if (!write_all(header, stream_write_header(header))) {
+        close(fd);
+        return false;
+    }
+
+    stream_encoder_init(&encoder);
+    for (usize i = 0; i < STREAM_POOL; i++) {
+        free_frames[i] = i;
+    }
+    num_free = STREAM_POOL;
+    queue_head = 0;
+    queue_length = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.bytes = STREAM_HEADER_BYTES;
+    stopping = false;
+    failed = false;
+    if (pthread_create(&writer, NULL, stream_writer, NULL)) {
+        close(fd);
+        return false;
+    }
+    active = true;
+    return true;
+}
+
+bool stream_active(void)
+{
+    return active;
+}
+
+ExportFrame *stream_acquire(void)
+{
+    pthread_mutex_lock(&lock);
+    ExportFrame *frame = NULL;
+    if (num_free > 0 && !failed) {
+        num_free -= 1;
+        frame = &frames[free_frames[num_free]];
+        memory_use(&pools[FRAME_POOL], STREAM_POOL - num_free);
+    } else {
+        stats.dropped += 1;
+    }
+    pthread_mutex_unlock(&lock);
+    return frame;
+}
+
+void stream_submit(ExportFrame *frame)
+{
+    usize idx = frame - frames;
+    assert(idx < STREAM_POOL);
+    pthread_mutex_lock(&lock);
+    queue[(queue_head + queue_length) % STREAM_POOL] = idx;
+    queue_length += 1;
+    pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&lock);
+}
+
+StreamStats stream_close(void)
+{
+    assert(active);
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    close(fd);
+    active = false;
+    return stats;
+}
+
+usize stream_memory(const MemoryPool **out)
+{
+    *out = pools;
+    return NUM_POOLS;
+}
@@ -0,0 +1,10 @@
+#include <time.h>
+
+#include "timer.h"
+
+f64 timer_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
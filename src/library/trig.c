@@ -0,0 +1,34 @@
+#include <string.h>
+
+#include "trig.h"
+
+typedef struct {
+    u64 key;
+    bool valid;
+    Rotation r;
+} TrigSlot;
+
+/* Per thread, so job threads rotating entities never share slots */
+static _Thread_local TrigSlot cache[TRIG_CACHE_SLOTS];
+static _Thread_local TrigStats stats;
+
+Rotation trig_rotation(f64 theta)
+{
+    u64 key;
+    memcpy(&key, &theta, sizeof(key));
+    TrigSlot *slot = &cache[(key * 0x9e3779b97f4a7c15) >> (64 - TRIG_CACHE_BITS)];
+    if (slot->valid && slot->key == key) {
+        stats.hits += 1;
+        return slot->r;
+    }
+    stats.misses += 1;
+    slot->key = key;
+    slot->valid = true;
+    slot->r = trig_rotation_uncached(theta);
+    return slot->r;
+}
+
+TrigStats trig_stats(void)
+{
+    return stats;
+}
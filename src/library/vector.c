@@ -1,42 +1,46 @@
 #include "vector.h"
+#include "trig.h"
 
 Vector2 vec(f64 x, f64 y)
 {
-    return (Vector2) { x, y };
+    return (Vector2) { scalar_from_f64(x), scalar_from_f64(y) };
 }
 
 Vector2 vec_mul(f64 a, Vector2 v)
 {
-    return vec(a * v.x, a * v.y);
+    Scalar s = scalar_from_f64(a);
+    return (Vector2) { scalar_mul(s, v.x), scalar_mul(s, v.y) };
 }
 
 Vector2 vec_add(Vector2 v1, Vector2 v2)
 {
-    return vec(v1.x + v2.x, v1.y + v2.y);
+    return (Vector2) { v1.x + v2.x, v1.y + v2.y };
 }
 
 Vector2 vec_sub(Vector2 v1, Vector2 v2)
 {
-    return vec(v1.x - v2.x, v1.y - v2.y);
+    return (Vector2) { v1.x - v2.x, v1.y - v2.y };
 }
 
-f64 vec_dot(Vector2 v1, Vector2 v2)
+WideScalar vec_dot(Vector2 v1, Vector2 v2)
 {
-    return v1.x * v2.x + v1.y * v2.y;
+    return wide_mul(v1.x, v2.x) + wide_mul(v1.y, v2.y);
 }
 
-f64 vec_cross(Vector2 v1, Vector2 v2)
+WideScalar vec_cross(Vector2 v1, Vector2 v2)
 {
-    return v1.x * v2.y - v1.y * v2.x;
+    return wide_mul(v1.x, v2.y) - wide_mul(v1.y, v2.x);
 }
 
 Vector2 vec_proj(Vector2 v, Vector2 u)
 {
-    return vec_mul(vec_dot(v, u) / vec_dot(u, u), u);
+    Scalar t = wide_div(vec_dot(v, u), vec_dot(u, u));
+    return (Vector2) { scalar_mul(t, u.x), scalar_mul(t, u.y) };
 }
 
 Vector2 vec_rotate(f64 theta, Vector2 v)
 {
-    return vec(v.x * cos(theta) - v.y * sin(theta),
-               v.x * sin(theta) + v.y * cos(theta));
+    Rotation r = trig_rotation(theta);
+    return (Vector2) { scalar_mul(v.x, r.c) - scalar_mul(v.y, r.s),
+                       scalar_mul(v.x, r.s) + scalar_mul(v.y, r.c) };
 }
@@ -0,0 +1,119 @@
+#include "vertex_arena.h"
+
+void arena_reset(VertexArena *arena)
+{
+    arena->free_length = 0;
+    arena->top = 0;
+    arena->used = 0;
+}
+
+bool arena_alloc(VertexArena *arena, usize n, VertexRange *range)
+{
+    assert(n > 0 && n <= MAX_POINTS);
+
+    // First fit among the holes, splitting off what is left
+    for (usize i = 0; i < arena->free_length; i++) {
+        VertexRange *hole = &arena->free_ranges[i];
+        if (hole->n < n) {
+            continue;
+        }
+        range->start = hole->start;
+        range->n = n;
+        hole->start += n;
+        hole->n -= n;
+        if (hole->n == 0) {
+            for (usize j = i; j < arena->free_length - 1; j++) {
+                arena->free_ranges[j] = arena->free_ranges[j+1];
+            }
+            arena->free_length -= 1;
+        }
+        arena->used += n;
+        return true;
+    }
+
+    if (arena->top + n > ARENA_VERTICES) {
+        return false;
+    }
+    range->start = arena->top;
+    range->n = n;
+    arena->top += n;
+    arena->used += n;
+    if (arena->top > arena->high_water) {
+        arena->high_water = arena->top;
+    }
+    return true;
+}
+
+void arena_free(VertexArena *arena, VertexRange range)
+{
+    assert(range.start + range.n <= arena->top);
+    arena->used -= range.n;
+
+    usize i = 0;
+    while (i < arena->free_length && arena->free_ranges[i].start < range.start) {
+        i++;
+    }
+
+    // Merge with the hole before and the hole after, if they touch
+    bool prev = i > 0 &&
+        arena->free_ranges[i-1].start + arena->free_ranges[i-1].n == range.start;
+    bool next = i < arena->free_length &&
+        range.start + range.n == arena->free_ranges[i].start;
+    if (prev) {
+        i -= 1;
+        arena->free_ranges[i].n += range.n;
+        if (next) {
+            arena->free_ranges[i].n += arena->free_ranges[i+1].n;
+            for (usize j = i + 1; j < arena->free_length - 1; j++) {
+                arena->free_ranges[j] = arena->free_ranges[j+1];
+            }
+            arena->free_length -= 1;
+        }
+    } else if (next) {
+        arena->free_ranges[i].start = range.start;
+        arena->free_ranges[i].n += range.n;
+    } else {
+        assert(arena->free_length < MAX_ENTITIES);
+        for (usize j = arena->free_length; j > i; j--) {
+            arena->free_ranges[j] = arena->free_ranges[j-1];
+        }
+        arena->free_ranges[i] = range;
+        arena->free_length += 1;
+    }
+
+    // A hole that reaches the top just lowers it
+    VertexRange *last = &arena->free_ranges[arena->free_length - 1];
+    if (last->start + last->n == arena->top) {
+        arena->top = last->start;
+        arena->free_length -= 1;
+    }
+}
+
+bool arena_check(const VertexArena *arena)
+{
+    usize holes = 0;
+    for (usize i = 0; i < arena->free_length; i++) {
+        const VertexRange *hole = &arena->free_ranges[i];
+        // Holes must be non-empty, ordered and separated by live vertices
+        if (hole->n == 0 || hole->start + hole->n >= arena->top) {
+            return false;
+        }
+        if (i > 0) {
+            const VertexRange *prev = &arena->free_ranges[i-1];
+            if (prev->start + prev->n >= hole->start) {
+                return false;
+            }
+        }
+        holes += hole->n;
+    }
+    return arena->used + holes == arena->top;
+}
+
+Polygon arena_poly(const VertexArena *arena, VertexRange range)
+{
+    Polygon poly = {
+        .points = (Vector2 *) &arena->vertices[range.start],
+        .n = range.n,
+    };
+    return poly;
+}
@@ -0,0 +1,65 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "base.h"
+#include "state_export.h"
+
+/*
+ * Print snapshots published by the game with STATE_EXPORT set.
+ *
+ * Usage: state_reader [name] [samples] [interval ms] [-v]
+ *
+ * With samples 0 it samples forever. A fourth argument of -v prints every
+ * entity instead of a summary.
+ */
+
+const char *STATUS_NAMES[] = { "start", "playing", "over" };
+const char *KIND_NAMES[] = { "player", "asteroid", "bullet", "particle" };
+
+static void print_frame(const ExportFrame *frame, bool verbose)
+{
+    usize counts[4] = { 0 };
+    for (usize i = 0; i < frame->count; i++) {
+        counts[frame->entities[i].kind % 4] += 1;
+    }
+    printf("tick %lu score %lu %s quality %u: %lu asteroids, %lu bullets, %lu particles\n",
+            frame->tick, frame->score, STATUS_NAMES[frame->status % 3], frame->quality,
+            counts[EXPORT_ASTEROID], counts[EXPORT_BULLET], counts[EXPORT_PARTICLE]);
+    if (!verbose) {
+        return;
+    }
+    for (usize i = 0; i < frame->count; i++) {
+        const ExportEntity *e = &frame->entities[i];
+        printf("  %3u %-8s pos (%8.2f, %8.2f) theta %6.2f vel (%8.2f, %8.2f)\n",
+                e->id, KIND_NAMES[e->kind % 4], e->x, e->y, e->theta, e->vx, e->vy);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : STATE_EXPORT_NAME;
+    usize samples = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    usize interval_ms = argc > 3 ? strtoull(argv[3], NULL, 10) : 100;
+    bool verbose = argc > 4 && !strcmp(argv[4], "-v");
+
+    const ExportSegment *segment = export_attach(name);
+    if (segment == NULL) {
+        fprintf(stderr, "No compatible state export at %s\n", name);
+        return 1;
+    }
+
+    static ExportFrame frame;
+    for (usize i = 0; samples == 0 || i < samples; i++) {
+        if (i > 0) {
+            usleep(interval_ms * 1000);
+        }
+        if (export_read(segment, &frame)) {
+            print_frame(&frame, verbose);
+        } else {
+            fprintf(stderr, "Timed out waiting for a consistent frame\n");
+        }
+    }
+
+    export_detach(segment);
+    return 0;
+}
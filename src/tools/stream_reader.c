@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "base.h"
+#include "state_stream.h"
+
+/*
+ * Decode a delta-compressed state stream, from a file or live from the
+ * game over a Unix domain socket, standing in for a remote viewer.
+ *
+ * Usage: stream_reader <file | unix:socket path> [every] [-v]
+ *
+ * With a unix: target it listens on the socket and decodes the first game
+ * that connects to it (run the game with STATE_STREAM=unix:<path>). One
+ * frame in every (default 60) is printed, with every entity given -v.
+ */
+
+const char *STATUS_NAMES[] = { "start", "playing", "over" };
+const char *KIND_NAMES[] = { "player", "asteroid", "bullet", "particle" };
+
+static u8 buffer[STREAM_HEADER_BYTES + 2 * STREAM_MAX_FRAME_BYTES];
+
+static void print_frame(const ExportFrame *frame, bool verbose)
+{
+    usize counts[4] = { 0 };
+    for (usize i = 0; i < frame->count; i++) {
+        counts[frame->entities[i].kind % 4] += 1;
+    }
+    printf("tick %lu score %lu %s quality %u: %lu asteroids, %lu bullets, %lu particles\n",
+            frame->tick, frame->score, STATUS_NAMES[frame->status % 3], frame->quality,
+            counts[EXPORT_ASTEROID], counts[EXPORT_BULLET], counts[EXPORT_PARTICLE]);
+    if (!verbose) {
+        return;
+    }
+    for (usize i = 0; i < frame->count; i++) {
+        const ExportEntity *e = &frame->entities[i];
+        printf("  %3u %-8s pos (%8.2f, %8.2f) theta %6.2f vel (%8.2f, %8.2f)\n",
+                e->id, KIND_NAMES[e->kind % 4], e->x, e->y, e->theta, e->vx, e->vy);
+    }
+}
+
+static int open_source(const char *source)
+{
+    if (strncmp(source, "unix:", 5)) {
+        return open(source, O_RDONLY);
+    }
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(source + 5) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, source + 5);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    unlink(addr.sun_path);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) || listen(sock, 1)) {
+        close(sock);
+        return -1;
+    }
+    fprintf(stderr, "Waiting for a game on %s\n", addr.sun_path);
+    int conn = accept(sock, NULL, NULL);
+    close(sock);
+    unlink(addr.sun_path);
+    return conn;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file | unix:socket path> [every] [-v]\n", argv[0]);
+        return 1;
+    }
+    usize every = argc > 2 ? strtoull(argv[2], NULL, 10) : 60;
+    bool verbose = argc > 3 && !strcmp(argv[3], "-v");
+    if (every == 0) every = 1;
+
+    int fd = open_source(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open %s\n", argv[1]);
+        return 1;
+    }
+
+    static StreamDecoder decoder;
+    static ExportFrame frame;
+    stream_decoder_init(&decoder);
+    usize length = 0;
+    u64 frames = 0;
+    u64 bytes = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(fd, buffer + length, sizeof(buffer) - length);
+        if (n <= 0) {
+            break;
+        }
+        length += n;
+        bytes += n;
+
+        usize offset = 0;
+        for (;;) {
+            usize consumed;
+            StreamResult result = stream_decode(
+                    &decoder, buffer + offset, length - offset, &consumed, &frame);
+            if (result == STREAM_ERROR) {
+                fprintf(stderr, "Corrupt stream after %lu frames\n", frames);
+                ok = false;
+                break;
+            }
+            if (result == STREAM_NEED_MORE) {
+                break;
+            }
+            offset += consumed;
+            if (frames % every == 0) {
+                print_frame(&frame, verbose);
+            }
+            frames += 1;
+        }
+        if (!ok) {
+            break;
+        }
+        memmove(buffer, buffer + offset, length - offset);
+        length -= offset;
+    }
+    close(fd);
+
+    printf("%lu frames, %lu bytes, %.1f bytes/frame\n",
+            frames, bytes, frames ? (f64) bytes / frames : 0.0);
+    if (length > 0 && ok) {
+        fprintf(stderr, "Stream ended inside a frame (%lu bytes left)\n", length);
+    }
+    return ok ? 0 : 1;
+}